@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Times duplicate tile lookup against a growing set of unique tiles, comparing
+// the hash index with the old linear scan over the tiles vector.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../image.h"
+#include "../tile.h"
+#include "../tileindex.h"
+#include "../tilestore.h"
+
+static Image *create_random_image(int numTiles, std::mt19937 &rng) {
+    Image *image = new Image;
+    image->width = numTiles * TILE_WIDTH;
+    image->height = TILE_HEIGHT;
+    image->pixels.resize(image->width * image->height);
+    for (auto &pixel : image->pixels) {
+        pixel = (unsigned char)(rng() % MAX_COLOURS);
+    }
+    return image;
+}
+
+static double time_index(Image *image, int numTiles, bool mirrored) {
+    TileStore tiles;
+    TileIndex tileIndex(mirrored);
+    uint32_t id;
+    bool flippedX, flippedY;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numTiles; i++) {
+        Tile tile(image, i * TILE_WIDTH, 0);
+        TileAnalysis analysis;
+        tile.analyze(&analysis);
+        TileKey key = tileIndex.makeKey(tile, analysis);
+        if (!tileIndex.find(key, &id, &flippedX, &flippedY)) {
+            tileIndex.add(key, tiles.add(tile, analysis.colors));
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / numTiles;
+}
+
+// The scan find_duplicate() did before the index was added.
+static double time_linear(Image *image, int numTiles) {
+    std::vector<Tile> tiles;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numTiles; i++) {
+        Tile tile(image, i * TILE_WIDTH, 0);
+        bool duplicate = false;
+        for (const Tile &t : tiles) {
+            if (tile.isDataEqual(t)) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (!duplicate) {
+            tiles.push_back(tile);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / numTiles;
+}
+
+int main() {
+    std::mt19937 rng(1);
+
+    printf("%10s %16s %16s %16s\n", "tiles", "index ns/tile", "mirrored ns/tile", "linear ns/tile");
+    for (int numTiles = 1024; numTiles <= 65536; numTiles *= 2) {
+        Image *image = create_random_image(numTiles, rng);
+        double indexed = time_index(image, numTiles, false);
+        double mirrored = time_index(image, numTiles, true);
+        if (numTiles <= 16384) {
+            printf("%10d %16.1f %16.1f %16.1f\n", numTiles, indexed, mirrored, time_linear(image, numTiles));
+        } else {
+            printf("%10d %16.1f %16.1f %16s\n", numTiles, indexed, mirrored, "-");
+        }
+        delete image;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+// Times lodepng's deflate against parallel_zlib_compress when encoding
+// generated 8-bit indexed tile sheets: one of flat shapes, which compresses
+// well, and one of noise, which barely compresses. Each encode is checked
+// by decoding it again.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../lodepng.h"
+#include "../paralleldeflate.h"
+
+#define BENCH_RUNS 3
+#define SHEET_WIDTH 256
+#define SHEET_HEIGHT 8192
+
+typedef struct {
+    const char *name;
+    unsigned windowSize;
+    unsigned niceMatch;
+    unsigned lazyMatching;
+} BenchSettings;
+
+static const BenchSettings SETTINGS[] = {
+    {"default", 2048, 128, 1},
+    {"max", 32768, 258, 1},
+};
+
+static const int THREAD_COUNTS[] = {1, 2, 4, 8};
+
+// Tiles of a few rectangles over a background, from a small set of colours.
+static std::vector<unsigned char> make_shapes(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<unsigned char> pixels(SHEET_WIDTH * SHEET_HEIGHT, 0);
+    for (int ty = 0; ty < SHEET_HEIGHT; ty += 8) {
+        for (int tx = 0; tx < SHEET_WIDTH; tx += 8) {
+            int numRects = rng() % 4;
+            for (int r = 0; r < numRects; r++) {
+                int x0 = rng() % 8, y0 = rng() % 8;
+                int x1 = x0 + rng() % (8 - x0), y1 = y0 + rng() % (8 - y0);
+                unsigned char color = (unsigned char) (rng() % 16);
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        pixels[(ty + y) * SHEET_WIDTH + tx + x] = color;
+                    }
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+static std::vector<unsigned char> make_noise(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<unsigned char> pixels(SHEET_WIDTH * SHEET_HEIGHT);
+    for (unsigned char &pixel : pixels) {
+        pixel = (unsigned char) (rng() % 16);
+    }
+    return pixels;
+}
+
+// Best of BENCH_RUNS encodes in ms, with the PNG size. threads is 0 for
+// lodepng's own deflate. Returns a negative time if the PNG does not decode
+// back to the pixels.
+static double time_encode(const std::vector<unsigned char> &pixels, const BenchSettings &settings, int threads,
+                          size_t *size) {
+    double best = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        lodepng::State state;
+        state.info_raw.colortype = LCT_PALETTE;
+        state.info_raw.bitdepth = 8;
+        for (int i = 0; i < 256; i++) {
+            lodepng_palette_add(&state.info_raw, i, i, i, 0xFF);
+        }
+        state.encoder.auto_convert = 0;
+        lodepng_color_mode_copy(&state.info_png.color, &state.info_raw);
+        state.encoder.zlibsettings.windowsize = settings.windowSize;
+        state.encoder.zlibsettings.nicematch = settings.niceMatch;
+        state.encoder.zlibsettings.lazymatching = settings.lazyMatching;
+        if (threads > 0) {
+            state.encoder.zlibsettings.custom_zlib = parallel_zlib_compress;
+            state.encoder.zlibsettings.custom_context = &threads;
+        }
+
+        std::vector<unsigned char> png;
+        auto start = std::chrono::steady_clock::now();
+        unsigned error = lodepng::encode(png, pixels, SHEET_WIDTH, SHEET_HEIGHT, state);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (error) {
+            return -1;
+        }
+        best = run == 0 ? ms : std::min(best, ms);
+        *size = png.size();
+
+        if (run == 0) {
+            std::vector<unsigned char> decoded;
+            unsigned width, height;
+            if (lodepng::decode(decoded, width, height, png, LCT_PALETTE, 8) || decoded != pixels) {
+                return -1;
+            }
+        }
+    }
+    return best;
+}
+
+int main() {
+    static const char *SHEET_NAMES[] = {"shapes", "noise"};
+    std::vector<unsigned char> sheets[] = {make_shapes(1), make_noise(1)};
+
+    printf("%dx%d sheets, best of %d\n", SHEET_WIDTH, SHEET_HEIGHT, BENCH_RUNS);
+    printf("sheet  settings %-18s", "lodepng");
+    for (int threads : THREAD_COUNTS) {
+        printf(" %d thread%-10s", threads, threads == 1 ? "" : "s");
+    }
+    printf("\n");
+    for (int s = 0; s < 2; s++) {
+        for (const BenchSettings &settings : SETTINGS) {
+            printf("%-6s %-8s", SHEET_NAMES[s], settings.name);
+            for (int t = -1; t < (int) (sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0])); t++) {
+                size_t size = 0;
+                double ms = time_encode(sheets[s], settings, t < 0 ? 0 : THREAD_COUNTS[t], &size);
+                char cell[32];
+                if (ms < 0) {
+                    snprintf(cell, sizeof(cell), "FAILED");
+                } else {
+                    snprintf(cell, sizeof(cell), "%.1fms %luB", ms, (unsigned long) size);
+                }
+                printf(" %-18s", cell);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+// Times reduceToNBuckets' search modes on generated palette problems: the
+// 2-4 bucket cases the original DFS handled, and 8-16 bucket cases with
+// smaller palettes. Each problem hides a valid answer: numBuckets palettes
+// that share their first sharedColors colours (a common background, say)
+// and split the rest, with every input drawn from one of them.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../palette.h"
+
+#define NUM_BENCH_SEEDS 5
+#define BENCH_TIMEOUT_MS 2000
+
+typedef struct {
+    int numBuckets;
+    int paletteSize;
+    int sharedColors;
+    int numInputs;
+    int minColors;
+    int maxColors;
+} BenchCase;
+
+static const BenchCase CASES[] = {
+    {2, 16, 0, 200, 2, 6},
+    {2, 16, 2, 200, 2, 6},
+    {3, 16, 2, 400, 2, 6},
+    {4, 16, 0, 600, 2, 6},
+    {4, 16, 2, 600, 2, 6},
+    {4, 16, 2, 3000, 2, 5},
+    {8, 16, 2, 1000, 2, 6},
+    {8, 4, 1, 400, 2, 3},
+    {12, 8, 2, 1000, 2, 5},
+    {16, 16, 0, 3000, 2, 6},
+    {16, 16, 2, 3000, 2, 6},
+    {16, 4, 1, 1000, 2, 3},
+};
+
+static std::vector<ColorSet> make_inputs(const BenchCase &c, uint32_t seed) {
+    std::mt19937 rng(seed);
+    int ownColors = c.paletteSize - c.sharedColors;
+    std::vector<int> colors(c.sharedColors + c.numBuckets * ownColors);
+    for (size_t i = 0; i < colors.size(); i++) {
+        colors[i] = (int) i;
+    }
+    std::shuffle(colors.begin(), colors.end(), rng);
+
+    std::vector<ColorSet> inputs;
+    for (int i = 0; i < c.numInputs; i++) {
+        int bucket = rng() % c.numBuckets;
+        int count = c.minColors + rng() % (c.maxColors - c.minColors + 1);
+        ColorSet input;
+        for (int j = 0; j < count; j++) {
+            int k = rng() % c.paletteSize;
+            input.insert(k < c.sharedColors ? colors[k] : colors[c.sharedColors + bucket * ownColors + k - c.sharedColors]);
+        }
+        inputs.push_back(input);
+    }
+    return inputs;
+}
+
+static bool is_valid(const std::vector<ColorSet> &inputs, const std::vector<ColorSet> &buckets, size_t maxSize) {
+    for (const ColorSet &bucket : buckets) {
+        if (bucket.size() > maxSize) return false;
+    }
+    for (const ColorSet &input : inputs) {
+        bool found = false;
+        for (const ColorSet &bucket : buckets) {
+            if (input.isSubsetOf(bucket)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+int main() {
+    static const PaletteSearchMode MODES[] = {PALETTE_SEARCH_SIZE_ORDERED, PALETTE_SEARCH_EXACT, PALETTE_SEARCH_DEFAULT};
+    static const char *MODE_NAMES[] = {"size-ordered", "exact", "default"};
+
+    printf("buckets size shared inputs  %-14s %-14s %-14s\n", MODE_NAMES[0], MODE_NAMES[1], MODE_NAMES[2]);
+    for (const BenchCase &c : CASES) {
+        printf("%7d %4d %6d %6d ", c.numBuckets, c.paletteSize, c.sharedColors, c.numInputs);
+        for (int m = 0; m < 3; m++) {
+            // The original DFS only ever handled up to four buckets.
+            if (MODES[m] == PALETTE_SEARCH_SIZE_ORDERED && c.numBuckets > 4) {
+                printf(" %-14s", "-");
+                continue;
+            }
+            double totalMs = 0;
+            int solved = 0;
+            for (uint32_t seed = 1; seed <= NUM_BENCH_SEEDS; seed++) {
+                std::vector<ColorSet> inputs = make_inputs(c, seed);
+                PaletteSearchOptions options = {BENCH_TIMEOUT_MS, MODES[m], true, 0};
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    std::vector<ColorSet> buckets = reduceToNBuckets(inputs, c.numBuckets, c.paletteSize, options);
+                    if (is_valid(inputs, buckets, c.paletteSize)) {
+                        solved++;
+                    } else {
+                        printf("INVALID ");
+                    }
+                } catch (const std::exception &) {
+                }
+                totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            char cell[32];
+            snprintf(cell, sizeof(cell), "%d/%d %.1fms", solved, NUM_BENCH_SEEDS, totalMs / NUM_BENCH_SEEDS);
+            printf(" %-14s", cell);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Compares the dispatched tile equality and hash kernels at every SIMD level
+// this CPU supports with the original byte-by-byte comparison loop.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../tile.h"
+#include "../tilesimd.h"
+
+#define NUM_BENCH_TILES 4096
+#define NUM_BENCH_ROUNDS 200
+
+// The loop Tile::isDataEqual used before the SIMD kernels.
+static bool byte_loop_equal(const unsigned char *a, const unsigned char *b) {
+    int count = 0;
+    for (; count < NUM_PIXELS_IN_TILE; count++) {
+        if (a[count] != b[count]) {
+            break;
+        }
+    }
+    return count == NUM_PIXELS_IN_TILE;
+}
+
+template<typename Func>
+static double time_ns_per_call(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)NUM_BENCH_TILES * NUM_BENCH_ROUNDS);
+}
+
+int main() {
+    std::mt19937 rng(1);
+    // Pairs of identical tiles: the worst case for an early-exit loop and the
+    // common case for a dedup hit.
+    std::vector<unsigned char> a(NUM_BENCH_TILES * NUM_PIXELS_IN_TILE);
+    for (auto &pixel : a) {
+        pixel = (unsigned char)(rng() % MAX_COLOURS);
+    }
+    std::vector<unsigned char> b = a;
+    std::vector<uint64_t> planesA(NUM_BENCH_TILES * TILE_NUM_PLANES);
+    for (int i = 0; i < NUM_BENCH_TILES; i++) {
+        tile_pack_planes(&a[i * NUM_PIXELS_IN_TILE], TILE_WIDTH, &planesA[i * TILE_NUM_PLANES]);
+    }
+    std::vector<uint64_t> planesB = planesA;
+
+    volatile uint64_t sink = 0;
+    double loop = time_ns_per_call([&]() {
+        for (int round = 0; round < NUM_BENCH_ROUNDS; round++) {
+            for (int i = 0; i < NUM_BENCH_TILES; i++) {
+                sink += byte_loop_equal(&a[i * NUM_PIXELS_IN_TILE], &b[i * NUM_PIXELS_IN_TILE]);
+            }
+        }
+    });
+    printf("%-8s equal %6.2f ns\n", "loop", loop);
+
+    uint64_t expectedHash = 0;
+    for (int level = TILE_SIMD_SCALAR; level <= TILE_SIMD_AVX512; level++) {
+        if (!tile_simd_set_level((TileSimdLevel)level)) {
+            printf("%-8s not supported\n", tile_simd_level_name((TileSimdLevel)level));
+            continue;
+        }
+
+        double equal = time_ns_per_call([&]() {
+            for (int round = 0; round < NUM_BENCH_ROUNDS; round++) {
+                for (int i = 0; i < NUM_BENCH_TILES; i++) {
+                    sink += tile_planes_equal(&planesA[i * TILE_NUM_PLANES], &planesB[i * TILE_NUM_PLANES]);
+                }
+            }
+        });
+        uint64_t hashes = 0;
+        double hash = time_ns_per_call([&]() {
+            for (int round = 0; round < NUM_BENCH_ROUNDS; round++) {
+                for (int i = 0; i < NUM_BENCH_TILES; i++) {
+                    hashes += tile_planes_hash(&planesA[i * TILE_NUM_PLANES]);
+                }
+            }
+        });
+        if (level == TILE_SIMD_SCALAR) {
+            expectedHash = hashes;
+        }
+        printf("%-8s equal %6.2f ns  hash %6.2f ns%s\n", tile_simd_level_name((TileSimdLevel)level), equal, hash,
+               hashes == expectedHash ? "" : "  HASH MISMATCH");
+    }
+    return 0;
+}
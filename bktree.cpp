@@ -0,0 +1,99 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "bktree.h"
+
+#include "tilesimd.h"
+
+void TileBkTree::add(const TileStore &tiles, uint32_t tile) {
+    Node node;
+    node.tile = tile;
+    node.distance = 0;
+    node.firstChild = -1;
+    node.nextSibling = -1;
+
+    if (nodes.empty()) {
+        nodes.push_back(node);
+        return;
+    }
+
+    int current = 0;
+    for (;;) {
+        int distance = tile_planes_distance(tiles.planes(nodes[current].tile), tiles.planes(tile));
+        if (distance == 0) {
+            // Identical content is already represented by the earlier tile.
+            return;
+        }
+
+        int child = nodes[current].firstChild;
+        while (child >= 0 && nodes[child].distance != distance) {
+            child = nodes[child].nextSibling;
+        }
+        if (child < 0) {
+            node.distance = distance;
+            node.nextSibling = nodes[current].firstChild;
+            nodes[current].firstChild = (int)nodes.size();
+            nodes.push_back(node);
+            return;
+        }
+        current = child;
+    }
+}
+
+int TileBkTree::findNearest(const TileStore &tiles, const uint64_t *planes, int maxDistance, uint32_t *tile,
+                            std::vector<int> *pending) const {
+    if (nodes.empty()) {
+        return -1;
+    }
+
+    int bestDistance = -1;
+    int radius = maxDistance;
+    pending->clear();
+    pending->push_back(0);
+
+    while (!pending->empty()) {
+        const Node &node = nodes[pending->back()];
+        pending->pop_back();
+
+        int distance = tile_planes_distance(tiles.planes(node.tile), planes);
+        if (distance <= radius) {
+            if (bestDistance < 0 || distance < bestDistance || (distance == bestDistance && node.tile < *tile)) {
+                bestDistance = distance;
+                *tile = node.tile;
+            }
+            // Keep searching at the same radius so ties resolve to the lowest id.
+            radius = distance;
+        }
+
+        // By the triangle inequality only children whose distance to this
+        // node is within radius of the query's distance can be close enough.
+        for (int child = node.firstChild; child >= 0; child = nodes[child].nextSibling) {
+            int d = nodes[child].distance;
+            if (d >= distance - radius && d <= distance + radius) {
+                pending->push_back(child);
+            }
+        }
+    }
+
+    return bestDistance;
+}
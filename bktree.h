@@ -0,0 +1,60 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_BKTREE_H
+#define PNG2TILE_BKTREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "tilestore.h"
+
+// Burkhard-Keller tree over tiles in a TileStore, keyed on the number of
+// pixels that differ between two tiles (tile_planes_distance). Finds every
+// tile within a pixel distance of a query without comparing against all of
+// them. Nodes live in one flat array and refer to tiles by store index.
+class TileBkTree {
+public:
+    void add(const TileStore &tiles, uint32_t tile);
+    // Returns the distance to the closest tile within maxDistance pixels and
+    // sets *tile to it (lowest id on ties), or returns -1 if there is none.
+    // pending is scratch space for the search, kept by the caller so
+    // repeated queries do not allocate.
+    int findNearest(const TileStore &tiles, const uint64_t *planes, int maxDistance, uint32_t *tile,
+                    std::vector<int> *pending) const;
+    std::size_t size() const { return nodes.size(); }
+
+private:
+    struct Node {
+        uint32_t tile;
+        // Distance from this node to its parent.
+        int distance;
+        // Children form a singly linked list; -1 terminates.
+        int firstChild;
+        int nextSibling;
+    };
+
+    std::vector<Node> nodes;
+};
+
+#endif //PNG2TILE_BKTREE_H
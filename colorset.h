@@ -0,0 +1,167 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_COLORSET_H
+#define PNG2TILE_COLORSET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#define COLOR_SET_BITS 256
+#define COLOR_SET_WORDS (COLOR_SET_BITS / 64)
+
+// A set of palette indices 0-255 held as a 256-bit mask, so that union is an
+// OR, size is a popcount and a subset test is (a & ~b) == 0.
+class ColorSet {
+public:
+    uint64_t words[COLOR_SET_WORDS];
+
+    ColorSet() : words() {}
+
+    static ColorSet fromSet(const std::set<int> &colors) {
+        ColorSet result;
+        for (int color : colors) {
+            result.insert(color);
+        }
+        return result;
+    }
+
+    std::set<int> toSet() const {
+        std::vector<int> list = colors();
+        return std::set<int>(list.begin(), list.end());
+    }
+
+    // The colours in ascending order.
+    std::vector<int> colors() const {
+        std::vector<int> result;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                result.push_back(w * 64 + countTrailingZeros(bits));
+            }
+        }
+        return result;
+    }
+
+    void insert(int color) {
+        words[color >> 6] |= 1ULL << (color & 63);
+    }
+
+    bool contains(int color) const {
+        return (words[color >> 6] >> (color & 63)) & 1;
+    }
+
+    bool empty() const {
+        return (words[0] | words[1] | words[2] | words[3]) == 0;
+    }
+
+    std::size_t size() const {
+        std::size_t count = 0;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            count += popcount(words[w]);
+        }
+        return count;
+    }
+
+    bool isSubsetOf(const ColorSet &other) const {
+        uint64_t outside = 0;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            outside |= words[w] & ~other.words[w];
+        }
+        return outside == 0;
+    }
+
+    bool intersects(const ColorSet &other) const {
+        uint64_t common = 0;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            common |= words[w] & other.words[w];
+        }
+        return common != 0;
+    }
+
+    // Removes every colour in other.
+    void erase(const ColorSet &other) {
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            words[w] &= ~other.words[w];
+        }
+    }
+
+    ColorSet &operator|=(const ColorSet &other) {
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            words[w] |= other.words[w];
+        }
+        return *this;
+    }
+
+    friend ColorSet operator|(ColorSet lhs, const ColorSet &rhs) {
+        lhs |= rhs;
+        return lhs;
+    }
+
+    friend bool operator==(const ColorSet &lhs, const ColorSet &rhs) {
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            if (lhs.words[w] != rhs.words[w]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const ColorSet &lhs, const ColorSet &rhs) {
+        return !(lhs == rhs);
+    }
+
+    std::size_t hash() const {
+        uint64_t h = 0;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            h = (h ^ words[w]) * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 29;
+        }
+        return (std::size_t) h;
+    }
+
+    static int popcount(uint64_t v) {
+#if defined(__GNUC__)
+        return __builtin_popcountll(v);
+#else
+        v = v - ((v >> 1) & 0x5555555555555555ULL);
+        v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+        v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    // v must be non-zero.
+    static int countTrailingZeros(uint64_t v) {
+        return popcount((v & (0 - v)) - 1);
+    }
+};
+
+struct ColorSetHash {
+    std::size_t operator()(const ColorSet &set) const {
+        return set.hash();
+    }
+};
+
+#endif //PNG2TILE_COLORSET_H
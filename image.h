@@ -24,10 +24,14 @@ SOFTWARE.
 #ifndef PNG2TILE_IMAGE_H
 #define PNG2TILE_IMAGE_H
 
+#include <cstddef>
 #include <vector>
 
 #define MAX_COLOURS 16
 
+// Side of the square pixel blocks Image stores its pixels in.
+#define IMAGE_BLOCK_SIZE 8
+
 class Color {
 public:
     unsigned char red = 0;
@@ -52,10 +56,25 @@ public:
     }
 };
 
+// Pixels are palette indices stored tile-major: the image is cut into
+// IMAGE_BLOCK_SIZE square blocks, taken left to right and top to bottom,
+// and each block's pixels are stored row by row. Blocks at the right and
+// bottom edges of an image that is not a whole number of blocks are padded
+// with index 0.
 typedef struct {
     unsigned int width, height;
     std::vector<Color> palette;
     std::vector<unsigned char> pixels;
 } Image;
 
+inline unsigned int image_blocks_wide(unsigned int width) {
+    return (width + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE;
+}
+
+// Offset in Image::pixels of the block holding pixel (x, y).
+inline std::size_t image_block_offset(const Image *image, unsigned int x, unsigned int y) {
+    return ((std::size_t) (y / IMAGE_BLOCK_SIZE) * image_blocks_wide(image->width) + x / IMAGE_BLOCK_SIZE)
+           * IMAGE_BLOCK_SIZE * IMAGE_BLOCK_SIZE;
+}
+
 #endif //PNG2TILE_IMAGE_H
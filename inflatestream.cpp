@@ -0,0 +1,414 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "inflatestream.h"
+
+#include <cstring>
+
+#define INFLATE_WINDOW_MASK (INFLATE_WINDOW_SIZE - 1)
+#define INFLATE_END_OF_BLOCK 256
+#define INFLATE_MAX_BITS 15
+// Largest number of bytes whose Adler-32 sums cannot overflow 32 bits.
+#define ADLER_BLOCK_SIZE 5552
+#define ADLER_MODULUS 65521
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// The order code length code lengths are stored in.
+static const unsigned char CODE_LENGTH_ORDER[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+InflateStream::InflateStream(const std::vector<InflateSegment> &segments)
+    : segments(segments), segment(0), position(0), bitBuffer(0), bitCount(0), overrun(false),
+      error(0), headerRead(false), finalBlock(false), inBlock(false), storedBlock(false), ended(false),
+      remaining(0), distance(0), window(INFLATE_WINDOW_SIZE, 0), windowPos(0), totalOut(0),
+      adlerA(1), adlerB(0) {
+}
+
+void InflateStream::refill() {
+    while (bitCount <= 56) {
+        while (segment < segments.size() && position >= segments[segment].size) {
+            segment++;
+            position = 0;
+        }
+        if (segment == segments.size()) {
+            return;
+        }
+        bitBuffer |= (uint64_t) segments[segment].data[position++] << bitCount;
+        bitCount += 8;
+    }
+}
+
+// Takes the next n bits, least significant first. Running out of input
+// sets overrun and returns 0.
+uint32_t InflateStream::bits(int n) {
+    if (bitCount < n) {
+        refill();
+        if (bitCount < n) {
+            overrun = true;
+            return 0;
+        }
+    }
+    uint32_t value = (uint32_t) (bitBuffer & ((1ULL << n) - 1));
+    bitBuffer >>= n;
+    bitCount -= n;
+    return value;
+}
+
+unsigned InflateStream::buildHuffman(Huffman *huffman, const unsigned char *lengths, int numSymbols) {
+    memset(huffman->counts, 0, sizeof(huffman->counts));
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    for (int i = 0; i < numSymbols; i++) {
+        huffman->counts[lengths[i]]++;
+    }
+    huffman->counts[0] = 0;
+
+    // Over-subscribed codes are invalid; incomplete ones are allowed and
+    // fail only if an unused code is met.
+    int left = 1;
+    uint16_t offsets[INFLATE_MAX_BITS + 2];
+    offsets[1] = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left = (left << 1) - huffman->counts[len];
+        if (left < 0) {
+            return 55;
+        }
+        offsets[len + 1] = offsets[len] + huffman->counts[len];
+    }
+
+    // Canonical codes are assigned in symbol order within each length.
+    uint32_t nextCode[INFLATE_MAX_BITS + 1];
+    uint32_t code = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code = (code + huffman->counts[len - 1]) << 1;
+        nextCode[len] = code;
+    }
+    for (int symbol = 0; symbol < numSymbols; symbol++) {
+        int len = lengths[symbol];
+        if (len == 0) {
+            continue;
+        }
+        huffman->symbols[offsets[len]++] = (uint16_t) symbol;
+        if (len <= INFLATE_FAST_BITS) {
+            // Codes are stored most significant bit first, input is read
+            // least significant bit first.
+            uint32_t reversed = 0;
+            for (int i = 0, c = (int) nextCode[len]; i < len; i++, c >>= 1) {
+                reversed = (reversed << 1) | (c & 1);
+            }
+            for (uint32_t i = reversed; i < (1u << INFLATE_FAST_BITS); i += 1u << len) {
+                huffman->fast[i] = (uint16_t) ((symbol << 4) | len);
+            }
+        }
+        nextCode[len]++;
+    }
+    return 0;
+}
+
+// Returns the next symbol, or -1 for a code not in the table.
+int InflateStream::decodeSymbol(const Huffman &huffman) {
+    if (bitCount < INFLATE_MAX_BITS) {
+        refill();
+    }
+    uint16_t entry = huffman.fast[bitBuffer & ((1u << INFLATE_FAST_BITS) - 1)];
+    if (entry != 0) {
+        int len = entry & 15;
+        if (len > bitCount) {
+            overrun = true;
+            return -1;
+        }
+        bitBuffer >>= len;
+        bitCount -= len;
+        return entry >> 4;
+    }
+
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code |= (int) bits(1);
+        int count = huffman.counts[len];
+        if (code - first < count) {
+            return huffman.symbols[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+unsigned InflateStream::readHeader() {
+    uint32_t cmf = bits(8);
+    uint32_t flg = bits(8);
+    if (overrun) {
+        return 53;
+    }
+    if ((cmf * 256 + flg) % 31 != 0) {
+        return 24;
+    }
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7) {
+        return 25;
+    }
+    if ((flg >> 5) & 1) {
+        return 26;
+    }
+    headerRead = true;
+    return 0;
+}
+
+unsigned InflateStream::readDynamicCodes() {
+    int numLiterals = (int) bits(5) + 257;
+    int numDistances = (int) bits(5) + 1;
+    int numCodeLengths = (int) bits(4) + 4;
+
+    unsigned char lengths[288 + 32] = {0};
+    for (int i = 0; i < numCodeLengths; i++) {
+        lengths[CODE_LENGTH_ORDER[i]] = (unsigned char) bits(3);
+    }
+    Huffman codeLengths;
+    unsigned result = buildHuffman(&codeLengths, lengths, 19);
+    if (result) {
+        return result;
+    }
+
+    // Literal and distance code lengths form one run-length coded sequence.
+    int total = numLiterals + numDistances;
+    memset(lengths, 0, sizeof(lengths));
+    for (int i = 0; i < total;) {
+        int symbol = decodeSymbol(codeLengths);
+        if (overrun) {
+            return 23;
+        }
+        if (symbol < 0) {
+            return 16;
+        }
+        if (symbol < 16) {
+            lengths[i++] = (unsigned char) symbol;
+            continue;
+        }
+
+        unsigned char value = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (i == 0) {
+                return 54;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + (int) bits(2);
+        } else if (symbol == 17) {
+            repeat = 3 + (int) bits(3);
+        } else {
+            repeat = 11 + (int) bits(7);
+        }
+        if (i + repeat > total) {
+            return 13;
+        }
+        memset(&lengths[i], value, (std::size_t) repeat);
+        i += repeat;
+    }
+    if (lengths[INFLATE_END_OF_BLOCK] == 0) {
+        return 64;
+    }
+
+    result = buildHuffman(&literals, lengths, numLiterals);
+    if (!result) {
+        result = buildHuffman(&distances, lengths + numLiterals, numDistances);
+    }
+    return result;
+}
+
+unsigned InflateStream::startBlock() {
+    finalBlock = bits(1) != 0;
+    uint32_t type = bits(2);
+    storedBlock = false;
+    if (type == 0) {
+        bits(bitCount % 8);
+        uint32_t len = bits(16);
+        uint32_t nlen = bits(16);
+        if (len + nlen != 65535) {
+            return 21;
+        }
+        storedBlock = true;
+        remaining = len;
+    } else if (type == 1) {
+        unsigned char lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        buildHuffman(&literals, lengths, 288);
+        memset(lengths, 5, 30);
+        buildHuffman(&distances, lengths, 30);
+    } else if (type == 2) {
+        unsigned result = readDynamicCodes();
+        if (result) {
+            return result;
+        }
+    } else {
+        return 20;
+    }
+    if (overrun) {
+        return 23;
+    }
+    inBlock = true;
+    return 0;
+}
+
+unsigned InflateStream::inflate(unsigned char *out, std::size_t size, std::size_t *produced) {
+    std::size_t done = 0;
+    while (done < size && !error) {
+        if (!inBlock) {
+            if (finalBlock) {
+                ended = true;
+                break;
+            }
+            error = startBlock();
+        } else if (storedBlock) {
+            if (remaining == 0) {
+                inBlock = false;
+                continue;
+            }
+            unsigned char byte = (unsigned char) bits(8);
+            if (overrun) {
+                error = 23;
+                break;
+            }
+            out[done++] = byte;
+            window[windowPos++ & INFLATE_WINDOW_MASK] = byte;
+            remaining--;
+        } else if (remaining > 0) {
+            // Copy the rest of a back reference, a byte at a time since the
+            // source may overlap what is being written.
+            std::size_t n = remaining < size - done ? remaining : size - done;
+            for (std::size_t i = 0; i < n; i++) {
+                unsigned char byte = window[(windowPos - distance) & INFLATE_WINDOW_MASK];
+                out[done++] = byte;
+                window[windowPos++ & INFLATE_WINDOW_MASK] = byte;
+            }
+            remaining -= n;
+        } else {
+            int symbol = decodeSymbol(literals);
+            if (overrun) {
+                error = 23;
+            } else if (symbol < 0) {
+                error = 16;
+            } else if (symbol < INFLATE_END_OF_BLOCK) {
+                out[done++] = (unsigned char) symbol;
+                window[windowPos++ & INFLATE_WINDOW_MASK] = (unsigned char) symbol;
+            } else if (symbol == INFLATE_END_OF_BLOCK) {
+                inBlock = false;
+            } else if (symbol - 257 >= 29) {
+                error = 16;
+            } else {
+                int lengthCode = symbol - 257;
+                std::size_t length = LENGTH_BASE[lengthCode] + bits(LENGTH_EXTRA[lengthCode]);
+                int distanceCode = decodeSymbol(distances);
+                if (distanceCode < 0 || distanceCode >= 30) {
+                    error = 18;
+                    break;
+                }
+                distance = DISTANCE_BASE[distanceCode] + bits(DISTANCE_EXTRA[distanceCode]);
+                if (overrun) {
+                    error = 23;
+                } else if (distance > totalOut + done) {
+                    error = 52;
+                } else {
+                    remaining = length;
+                }
+            }
+        }
+    }
+
+    // Adler-32 over what was produced, reduced before the sums can overflow.
+    for (std::size_t i = 0; i < done;) {
+        std::size_t end = i + ADLER_BLOCK_SIZE < done ? i + ADLER_BLOCK_SIZE : done;
+        for (; i < end; i++) {
+            adlerA += out[i];
+            adlerB += adlerA;
+        }
+        adlerA %= ADLER_MODULUS;
+        adlerB %= ADLER_MODULUS;
+    }
+    totalOut += done;
+    *produced = done;
+    return error;
+}
+
+unsigned InflateStream::read(unsigned char *out, std::size_t size) {
+    if (!error && !headerRead) {
+        error = readHeader();
+    }
+    if (error) {
+        return error;
+    }
+    std::size_t produced;
+    unsigned result = inflate(out, size, &produced);
+    if (!result && produced < size) {
+        error = 91;
+    }
+    return error;
+}
+
+unsigned InflateStream::finish() {
+    if (!error && !headerRead) {
+        error = readHeader();
+    }
+    if (error) {
+        return error;
+    }
+    // Only empty blocks or an end-of-block code may follow the data read.
+    unsigned char extra;
+    std::size_t produced;
+    unsigned result = inflate(&extra, 1, &produced);
+    if (result) {
+        return result;
+    }
+    if (produced != 0 || !ended) {
+        error = 91;
+        return error;
+    }
+
+    bits(bitCount % 8);
+    uint32_t adler = 0;
+    for (int i = 0; i < 4; i++) {
+        adler = (adler << 8) | bits(8);
+    }
+    if (overrun) {
+        error = 53;
+    } else if (adler != ((adlerB << 16) | adlerA)) {
+        error = 58;
+    }
+    return error;
+}
@@ -0,0 +1,103 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_INFLATESTREAM_H
+#define PNG2TILE_INFLATESTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Huffman codes are decoded with one table lookup when at most this many
+// bits long, and bit by bit otherwise.
+#define INFLATE_FAST_BITS 9
+#define INFLATE_WINDOW_SIZE 32768
+
+// A run of compressed bytes, e.g. the data of one PNG IDAT chunk.
+typedef struct {
+    const unsigned char *data;
+    std::size_t size;
+} InflateSegment;
+
+// Inflates a zlib stream incrementally, so the caller only ever holds as
+// much output as it asks for. The input may be split over several
+// segments, which must stay valid while the stream is read. Only the last
+// 32K of output is kept, for back references. Errors are lodepng error
+// codes, so they print with lodepng_error_text.
+class InflateStream {
+public:
+    explicit InflateStream(const std::vector<InflateSegment> &segments);
+
+    // Writes the next size bytes of output to out.
+    unsigned read(unsigned char *out, std::size_t size);
+    // Checks that the stream ends exactly here and its Adler-32 matches.
+    unsigned finish();
+
+private:
+    struct Huffman {
+        // (symbol << 4) | length for codes up to INFLATE_FAST_BITS long,
+        // indexed by the next bits of input; 0 for longer codes.
+        uint16_t fast[1 << INFLATE_FAST_BITS];
+        // Canonical decoding: codes per length and symbols in code order.
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    void refill();
+    uint32_t bits(int n);
+    static unsigned buildHuffman(Huffman *huffman, const unsigned char *lengths, int numSymbols);
+    int decodeSymbol(const Huffman &huffman);
+    unsigned readHeader();
+    unsigned startBlock();
+    unsigned readDynamicCodes();
+    // Inflates up to size bytes, fewer only if the stream ends first.
+    unsigned inflate(unsigned char *out, std::size_t size, std::size_t *produced);
+
+    std::vector<InflateSegment> segments;
+    std::size_t segment;
+    std::size_t position;
+    uint64_t bitBuffer;
+    int bitCount;
+    bool overrun;
+
+    unsigned error;
+    bool headerRead;
+    bool finalBlock;
+    bool inBlock;
+    bool storedBlock;
+    // The final block has been read to its end.
+    bool ended;
+    // Bytes left in a stored block, or of a back reference being copied.
+    std::size_t remaining;
+    std::size_t distance;
+
+    Huffman literals;
+    Huffman distances;
+    std::vector<unsigned char> window;
+    std::size_t windowPos;
+    std::size_t totalOut;
+    uint32_t adlerA;
+    uint32_t adlerB;
+};
+
+#endif //PNG2TILE_INFLATESTREAM_H
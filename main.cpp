@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <string>
 #include <iostream>
@@ -29,15 +30,35 @@ SOFTWARE.
 #include <vector>
 #include <fstream>
 #include <set>
+#include <thread>
+#include <unordered_map>
 
+#include "bktree.h"
+#include "colorset.h"
 #include "tile.h"
+#include "tileindex.h"
+#include "tilesimd.h"
+#include "tilestore.h"
 #include "lodepng.h"
 #include "image.h"
+#include "mappedfile.h"
 #include "palette.h"
+#include "palettemap.h"
+#include "paletteopt.h"
+#include "paralleldeflate.h"
+#include "pngtiles.h"
 #include "version.h"
+#include "workerpool.h"
 
 #define NUM_TILE_COLS_IN_PNG_IMAGE 16
 
+// Tile rows each extraction thread handles per batch.
+#define TILE_ROWS_PER_BAND 4
+
+#define MAX_PALETTES 16
+#define SMS_TILEMAP_MAX_PALETTES 2
+#define GEN_TILEMAP_MAX_PALETTES 4
+
 #define TMX_FLIP_X_FLAG 0x80000000
 #define TMX_FLIP_Y_FLAG 0x40000000
 
@@ -73,19 +94,29 @@ typedef enum {
     TILEMAP_FORMAT_GEN
 } TilemapOutputFormat;
 
+// How hard PNG output is compressed, see -pngEffort.
+typedef enum {
+    PNG_EFFORT_FAST,
+    PNG_EFFORT_DEFAULT,
+    PNG_EFFORT_MAX
+} PngEffort;
+
 typedef struct {
-    const char *input_filename;
+    std::vector<const char *> input_filenames;
     const char *output_tile_image_filename;
     const char *tmx_filename;
     const char *palette_filename;
     const char *tilemap_filename;
     const char *tiles_filename;
+    const char *base_tiles_filename;
     bool mirror;
     bool remove_dups;
     PaletteOutputFormat paletteOutputFormat;
     TileSize tileSize;
     TileOutputFormat tileOutputFormat;
     TilemapOutputFormat tilemapOutputFormat;
+    PngEffort pngEffort;
+    int pngThreads;
     int tile_start_offset;
     bool use_sprite_pal;
     bool infront_flag;
@@ -93,7 +124,17 @@ typedef struct {
     bool compress;
     bool quiet;
     int numPalettes;
+    int paletteSize;
     bool generateNewPal;
+    bool foldColors;
+    bool palSwapDupes;
+    bool palOptimize;
+    long palTimeoutMs;
+    bool palPortfolio;
+    bool palSeeded;
+    uint32_t palSeed;
+    int numThreads;
+    int maxDiff;
 } Config;
 
 // forwards for compressors
@@ -102,53 +143,59 @@ extern "C" {
 int STM_compressTilemap(uint8_t* source, uint32_t width, uint32_t height, uint8_t* dest, uint32_t destLen);
 }
 
-Image *read_png_file(const Config &config, const char *filename, bool quiet) {
-    std::vector<unsigned char> png;
-    Image *image = new Image;
+// Opens filename and reads its header and palette into reader, which then
+// decodes the pixels out of file as they are needed.
+bool open_png_file(const char *filename, MappedFile *file, PngTileReader *reader) {
     lodepng::State state;
+    unsigned int width, height;
 
-    unsigned error = lodepng::load_file(png, filename);
-    if (!error) error = lodepng_inspect(&image->width, &image->height, &state, &png[0], png.size());
+    unsigned error = file->open(filename);
+    if (!error) error = lodepng_inspect(&width, &height, &state, file->data(), file->size());
     if (error) {
         std::cout << "[read_png_file] error reading file " << error << ": "<< lodepng_error_text(error) << std::endl;
-        delete image;
-        return nullptr;
+        return false;
     }
 
     if (state.info_png.color.colortype != LCT_PALETTE) {
         printf("[read_png_file] Only indexed PNG files allowed\n");
-        delete image;
-        return nullptr;
+        return false;
     }
 
-    state.info_raw.colortype = LCT_PALETTE;
-    state.info_raw.bitdepth = 8;
+    error = reader->open(file->data(), file->size());
+    if (error) {
+        std::cout << "[read_png_file] decoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
+        return false;
+    }
+    return true;
+}
 
+Image *read_png_file(const Config &config, const char *filename, bool quiet) {
+    MappedFile file;
+    PngTileReader reader;
+    if (!open_png_file(filename, &file, &reader)) {
+        return nullptr;
+    }
 
-    if(!error) error = lodepng::decode(image->pixels, image->width, image->height, state, png);
+    Image *image = new Image;
+    unsigned error = reader.readBlockRows((reader.height() + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE, image);
     if (error) {
         std::cout << "[read_png_file] decoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
         delete image;
         return nullptr;
     }
-
-    for (int i = 0; i < state.info_png.color.palettesize; i++) {
-        image->palette.push_back(Color(state.info_png.color.palette[i * 4], state.info_png.color.palette[i * 4 + 1], state.info_png.color.palette[i * 4 + 2]));
-    }
+    image->palette = reader.palette();
 
     return image;
 }
 
-void write_png_file(const char *filename, int width, int height, const unsigned char *pixels, const std::vector<std::vector<Color>> &palettes) {
-    std::vector<unsigned char> png;
-    lodepng::State state;
-    state.info_raw.colortype = LCT_PALETTE;
-    state.info_raw.bitdepth = 8;
-
+void add_png_palette(LodePNGColorMode *mode, const std::vector<std::vector<Color>> &palettes, size_t maxEntries) {
     for (auto &palette : palettes) {
         for (auto &color : palette) {
+            if (mode->palettesize == maxEntries) {
+                return;
+            }
             lodepng_palette_add(
-                    &state.info_raw,
+                    mode,
                     color.red,
                     color.green,
                     color.blue,
@@ -156,10 +203,105 @@ void write_png_file(const char *filename, int width, int height, const unsigned
             );
         }
     }
-    unsigned error = lodepng::encode(png, pixels, (unsigned )width, (unsigned )height, state);
-    if(!error) lodepng::save_file(png, filename);
+}
+
+// With -pngThreads the image data is deflated in chunks on several threads
+// instead of by lodepng.
+void set_png_deflate(const Config &config, LodePNGCompressSettings *settings) {
+    if (config.pngThreads > 0) {
+        settings->custom_zlib = parallel_zlib_compress;
+        settings->custom_context = &config.pngThreads;
+    }
+}
+
+// Skips lodepng's colour analysis: pixels are packed at the smallest bit
+// depth holding the largest index, filtered with filter 0 and deflated with
+// Huffman coding only.
+unsigned encode_png_fast(const Config &config, std::vector<unsigned char> &png, int width, int height,
+                         const unsigned char *pixels, const std::vector<std::vector<Color>> &palettes) {
+    size_t numPixels = (size_t) width * height;
+    unsigned char maxIndex = 0;
+    for (size_t i = 0; i < numPixels; i++) {
+        maxIndex = std::max(maxIndex, pixels[i]);
+    }
+    unsigned bitDepth = 1;
+    while ((1u << bitDepth) <= maxIndex) {
+        bitDepth *= 2;
+    }
+
+    lodepng::State state;
+    state.info_raw.colortype = LCT_PALETTE;
+    state.info_raw.bitdepth = bitDepth;
+    add_png_palette(&state.info_raw, palettes, (size_t) 1 << bitDepth);
+    while (state.info_raw.palettesize <= maxIndex) {
+        lodepng_palette_add(&state.info_raw, 0, 0, 0, 0xFF);
+    }
+    lodepng_color_mode_copy(&state.info_png.color, &state.info_raw);
+    state.encoder.auto_convert = 0;
+    state.encoder.filter_palette_zero = 1;
+    state.encoder.zlibsettings.use_lz77 = 0;
+    set_png_deflate(config, &state.encoder.zlibsettings);
+
+    // lodepng packs sub-byte pixels without padding rows to whole bytes.
+    std::vector<unsigned char> packed;
+    if (bitDepth == 8) {
+        packed.assign(pixels, pixels + numPixels);
+    } else {
+        unsigned pixelsPerByte = 8 / bitDepth;
+        packed.assign((numPixels * bitDepth + 7) / 8, 0);
+        for (size_t i = 0; i < numPixels; i++) {
+            packed[i / pixelsPerByte] |= pixels[i] << (8 - bitDepth * (i % pixelsPerByte + 1));
+        }
+    }
+    return lodepng::encode(png, packed, (unsigned) width, (unsigned) height, state);
+}
+
+void write_png_file(const Config &config, const char *filename, int width, int height, const unsigned char *pixels,
+                    const std::vector<std::vector<Color>> &palettes) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> png;
+    unsigned error;
+
+    if (config.pngEffort == PNG_EFFORT_FAST) {
+        error = encode_png_fast(config, png, width, height, pixels, palettes);
+    } else {
+        lodepng::State state;
+        state.info_raw.colortype = LCT_PALETTE;
+        state.info_raw.bitdepth = 8;
+        add_png_palette(&state.info_raw, palettes, 256);
+        set_png_deflate(config, &state.encoder.zlibsettings);
+
+        if (config.pngEffort == PNG_EFFORT_DEFAULT) {
+            error = lodepng::encode(png, pixels, (unsigned) width, (unsigned) height, state);
+        } else {
+            // The full deflate window and match length, with each filter
+            // strategy that can win on tile sheets. The smallest is kept.
+            static const LodePNGFilterStrategy strategies[] = {LFS_ZERO, LFS_MINSUM, LFS_ENTROPY};
+            state.encoder.zlibsettings.windowsize = 32768;
+            state.encoder.zlibsettings.nicematch = 258;
+            state.encoder.zlibsettings.lazymatching = 1;
+            state.encoder.filter_palette_zero = 0;
+            error = 0;
+            for (LodePNGFilterStrategy strategy : strategies) {
+                std::vector<unsigned char> candidate;
+                state.encoder.filter_strategy = strategy;
+                error = lodepng::encode(candidate, pixels, (unsigned) width, (unsigned) height, state);
+                if (error) {
+                    break;
+                }
+                if (png.empty() || candidate.size() < png.size()) {
+                    png.swap(candidate);
+                }
+            }
+        }
+    }
+
+    double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if(!error) error = lodepng::save_file(png, filename);
     if (error) {
         std::cout << "[write_png_file] encoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
+    } else if (!config.quiet) {
+        printf("Wrote \"%s\": %lu bytes, encoded in %.1f ms\n", filename, (unsigned long) png.size(), encodeMs);
     }
 }
 
@@ -170,7 +312,11 @@ void show_version() {
 void show_usage() {
     show_version();
     std::string s = "Usage:\n"
-            "png2tile <input_filename> [options]\n"
+            "png2tile <input_filename> [<input_filename>...] [options]\n"
+            "\n"
+            "Several input images can be given. They are converted together into one\n"
+            "shared tileset, with a tilemap per image. Their palettes should match;\n"
+            "colours are taken from the first image.\n"
             "\n"
             "Option               Effect\n"
             "\n"
@@ -209,16 +355,60 @@ void show_usage() {
             "                     sms_cl123  Output the palette in SMS colour format\n"
             "                                eg cl123, cl333, cl001\n"
             "\n"
-            "-numPals <number>    Number of 16 color palettes to use. *Default is 1.\n"
+            "-numPals <number>    Number of palettes to use, up to 16. *Default is 1.\n"
+            "\n"
+            "-palSize <number>    Number of colors in each palette, up to 16.\n"
+            "                     *Default is 16.\n"
             "\n"
             "-generateNewPal      Generate a new palette from the input image.\n"
             "                     *Default is unset.\n"
             "\n"
+            "-foldColors          Treat palette entries that the -pal format outputs as\n"
+            "                     the same hardware colour as one colour, so that tiles\n"
+            "                     differing only in those entries dedup and palettes\n"
+            "                     need fewer colours. *Default is unset.\n"
+            "\n"
+            "-palTimeout <ms>     Give up generating palettes after <ms> milliseconds.\n"
+            "                     *Default is 0 (no limit).\n"
+            "\n"
+            "-palPortfolio        Generate palettes by racing several search strategies\n"
+            "                     on separate threads. *Default is unset.\n"
+            "\n"
+            "-palOptimize         With -generateNewPal, improve the palettes found by\n"
+            "                     moving colour sets between them: first to leave fewer\n"
+            "                     tiles after -palSwapDupes, then to leave more palette\n"
+            "                     entries free. *Default is unset.\n"
+            "\n"
+            "-palSeed <n>         Seed for the randomized palette searches. Also makes\n"
+            "                     -palPortfolio deterministic. *Default is 0.\n"
+            "\n"
+            "-palSwapDupes        After palettes are assigned, also remove tiles that are\n"
+            "                     duplicates using a different palette. Their tilemap\n"
+            "                     cells select that palette instead. TMX output shows\n"
+            "                     them in the palette of the copy kept. *Default is unset.\n"
+            "\n"
+            "-maxdiff <pixels>    Treat a tile as a duplicate of an existing tile (or a\n"
+            "                     flipped version of it when mirroring) that differs in\n"
+            "                     at most <pixels> pixels. Lossy. Base tiles are only\n"
+            "                     matched exactly. *Default is 0 (exact).\n"
+            "\n"
+            "-threads <n>         Number of threads used to extract tiles. 0 uses one\n"
+            "                     thread per CPU core. Output does not depend on the\n"
+            "                     thread count. *Default is 1.\n"
+            "\n"
+            "-basetiles <filename>\n"
+            "                     Tiles already in VRAM. Matching tiles in the image use\n"
+            "                     these instead, numbered from the tile offset; new tiles\n"
+            "                     are numbered after them. <filename> is either a tile\n"
+            "                     PNG image or binary tile data in the -tileformat format.\n"
+            "\n"
             "-savetiles <filename>\n"
-            "                     Save tile data to <filename>.\n"
+            "                     Save tile data to <filename>. Base tiles are not saved.\n"
             "\n"
             "-savetilemap <filename>\n"
-            "                     Save tilemap data to <filename>. \n"
+            "                     Save tilemap data to <filename>. A %s in <filename> is\n"
+            "                     replaced by the input image name without extension,\n"
+            "                     which is required when there are several input images.\n"
             "\n"
             "-savepalette <filename>\n"
             "                     Save palette data to <filename>.\n"
@@ -228,7 +418,21 @@ void show_usage() {
             "\n"
             "-savetmx <filename> \n"
             "                     Save tilemap and corresponding tileset in the Tiled\n"
-            "                     mapeditor TMX format.\n"
+            "                     mapeditor TMX format. %s is handled as for -savetilemap.\n"
+            "                     The tileset is saved next to it with .png appended.\n"
+            "                     Several images share one, named as for an image\n"
+            "                     called tileset.\n"
+            "\n"
+            "-pngEffort <effort>  How hard -savetileimage and -savetmx compress PNGs.\n"
+            "                     fast: Huffman coding only, for quick previews.\n"
+            "                     default: lodepng's standard settings.\n"
+            "                     max: full window, smallest of several filter choices.\n"
+            "                     *Default is default.\n"
+            "\n"
+            "-pngThreads <n>      Deflate PNG image data in chunks on <n> threads instead\n"
+            "                     of with lodepng. 0 uses one thread per CPU core. The\n"
+            "                     PNG does not depend on the thread count but is a\n"
+            "                     little larger. *Default is unset.\n"
             "\n"
             "-binary \n"
             "                     Output binary files instead of asm source files.\n"
@@ -245,6 +449,27 @@ void show_usage() {
     std::cout << s;
 }
 
+// Replaces a "%s" in pattern with the input's file name minus directory and extension.
+std::string input_output_filename(const char *pattern, const char *input_filename) {
+    std::string filename = pattern;
+    size_t placeholder = filename.find("%s");
+    if (placeholder == std::string::npos) {
+        return filename;
+    }
+
+    std::string stem = input_filename;
+    size_t dir = stem.find_last_of("/\\");
+    if (dir != std::string::npos) {
+        stem = stem.substr(dir + 1);
+    }
+    size_t ext = stem.find_last_of('.');
+    if (ext != std::string::npos && ext > 0) {
+        stem = stem.substr(0, ext);
+    }
+
+    return filename.replace(placeholder, 2, stem);
+}
+
 Config parse_commandline_opts(int argc, char **argv) {
     Config config;
 
@@ -258,13 +483,15 @@ Config parse_commandline_opts(int argc, char **argv) {
         exit(1);
     }
 
-    config.input_filename = argv[1];
+    config.input_filenames.push_back(argv[1]);
     config.remove_dups = true;
     config.mirror = true;
     config.paletteOutputFormat = SMS;
     config.tileSize = TILE_8x8;
     config.tileOutputFormat = TILE_FORMAT_PLANAR;
     config.tilemapOutputFormat = TILEMAP_FORMAT_SMS;
+    config.pngEffort = PNG_EFFORT_DEFAULT;
+    config.pngThreads = 0;
     config.use_sprite_pal = false;
     config.infront_flag = false;
     config.tile_start_offset = 0;
@@ -272,13 +499,24 @@ Config parse_commandline_opts(int argc, char **argv) {
     config.compress = false;
     config.quiet = false;
     config.numPalettes = 1;
+    config.paletteSize = MAX_COLOURS;
     config.generateNewPal = false;
+    config.foldColors = false;
+    config.palSwapDupes = false;
+    config.palOptimize = false;
+    config.palTimeoutMs = 0;
+    config.palPortfolio = false;
+    config.palSeeded = false;
+    config.palSeed = 0;
+    config.numThreads = 1;
+    config.maxDiff = 0;
 
     config.output_tile_image_filename = nullptr;
     config.tmx_filename = nullptr;
     config.palette_filename = nullptr;
     config.tilemap_filename = nullptr;
     config.tiles_filename = nullptr;
+    config.base_tiles_filename = nullptr;
 
     for (int i = 2; i < argc; i++) {
         const char *option = argv[i];
@@ -366,6 +604,11 @@ Config parse_commandline_opts(int argc, char **argv) {
                 if (i < argc) {
                     config.tilemap_filename = argv[i];
                 }
+            } else if (strcmp(cmd, "basetiles") == 0) {
+                i++;
+                if (i < argc) {
+                    config.base_tiles_filename = argv[i];
+                }
             } else if (strcmp(cmd, "savepalette") == 0) {
                 i++;
                 if (i < argc) {
@@ -381,6 +624,32 @@ Config parse_commandline_opts(int argc, char **argv) {
                 if (i < argc) {
                     config.tmx_filename = argv[i];
                 }
+            } else if (strcmp(cmd, "pngEffort") == 0) {
+                i++;
+                if (i < argc) {
+                    if (strcmp(argv[i], "fast") == 0) {
+                        config.pngEffort = PNG_EFFORT_FAST;
+                    } else if (strcmp(argv[i], "default") == 0) {
+                        config.pngEffort = PNG_EFFORT_DEFAULT;
+                    } else if (strcmp(argv[i], "max") == 0) {
+                        config.pngEffort = PNG_EFFORT_MAX;
+                    } else {
+                        printf("Invalid PNG effort '%s'. Valid efforts are ('fast', 'default', 'max')\n", argv[i]);
+                        exit(1);
+                    }
+                }
+            } else if (strcmp(cmd, "pngThreads") == 0) {
+                i++;
+                if (i < argc) {
+                    config.pngThreads = strtol(argv[i], nullptr, 0);
+                    if (config.pngThreads < 0) {
+                        printf("Number of PNG threads cannot be negative\n");
+                        exit(1);
+                    }
+                    if (config.pngThreads == 0) {
+                        config.pngThreads = std::max(1, (int)std::thread::hardware_concurrency());
+                    }
+                }
             } else if (strcmp(cmd, "binary") == 0) {
                 config.output_bin = true;
             } else if (strcmp(cmd, "compress") == 0) {
@@ -394,13 +663,66 @@ Config parse_commandline_opts(int argc, char **argv) {
                     if (config.numPalettes == 0) {
                         config.numPalettes = 1;
                     }
-                    if (config.numPalettes > 4) {
-                        printf("Number of palettes cannot be greater than 4\n");
+                    if (config.numPalettes > MAX_PALETTES) {
+                        printf("Number of palettes cannot be greater than %d\n", MAX_PALETTES);
+                        exit(1);
+                    }
+                }
+            } else if (strcmp(cmd, "palSize") == 0) {
+                i++;
+                if (i < argc) {
+                    config.paletteSize = strtol(argv[i], nullptr, 0);
+                    if (config.paletteSize < 1 || config.paletteSize > MAX_COLOURS) {
+                        printf("Palette size must be between 1 and %d\n", MAX_COLOURS);
                         exit(1);
                     }
                 }
             } else if (strcmp(cmd, "generateNewPal") == 0) {
                 config.generateNewPal = true;
+            } else if (strcmp(cmd, "foldColors") == 0) {
+                config.foldColors = true;
+            } else if (strcmp(cmd, "palSwapDupes") == 0) {
+                config.palSwapDupes = true;
+            } else if (strcmp(cmd, "palOptimize") == 0) {
+                config.palOptimize = true;
+            } else if (strcmp(cmd, "palTimeout") == 0) {
+                i++;
+                if (i < argc) {
+                    config.palTimeoutMs = strtol(argv[i], nullptr, 0);
+                    if (config.palTimeoutMs < 0) {
+                        printf("Palette timeout cannot be negative\n");
+                        exit(1);
+                    }
+                }
+            } else if (strcmp(cmd, "palPortfolio") == 0) {
+                config.palPortfolio = true;
+            } else if (strcmp(cmd, "palSeed") == 0) {
+                i++;
+                if (i < argc) {
+                    config.palSeed = (uint32_t) strtoul(argv[i], nullptr, 0);
+                    config.palSeeded = true;
+                }
+            } else if (strcmp(cmd, "maxdiff") == 0) {
+                i++;
+                if (i < argc) {
+                    config.maxDiff = strtol(argv[i], nullptr, 0);
+                    if (config.maxDiff < 0 || config.maxDiff > NUM_PIXELS_IN_TILE) {
+                        printf("Max pixel difference must be between 0 and %d\n", NUM_PIXELS_IN_TILE);
+                        exit(1);
+                    }
+                }
+            } else if (strcmp(cmd, "threads") == 0) {
+                i++;
+                if (i < argc) {
+                    config.numThreads = strtol(argv[i], nullptr, 0);
+                    if (config.numThreads < 0) {
+                        printf("Number of threads cannot be negative\n");
+                        exit(1);
+                    }
+                    if (config.numThreads == 0) {
+                        config.numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+                    }
+                }
             } else if (strcmp(cmd, "version") == 0) {
                 show_version();
             } else {
@@ -408,6 +730,32 @@ Config parse_commandline_opts(int argc, char **argv) {
                 show_usage();
                 exit(1);
             }
+        } else {
+            config.input_filenames.push_back(option);
+        }
+    }
+
+    if (config.input_filenames.size() > 1) {
+        if (config.tilemap_filename != nullptr && strstr(config.tilemap_filename, "%s") == nullptr) {
+            printf("-savetilemap needs a %%s in the filename when converting several images\n");
+            exit(1);
+        }
+        if (config.tmx_filename != nullptr && strstr(config.tmx_filename, "%s") == nullptr) {
+            printf("-savetmx needs a %%s in the filename when converting several images\n");
+            exit(1);
+        }
+        // Images with the same name in different directories would write
+        // the same tilemap and TMX files.
+        if (config.tilemap_filename != nullptr || config.tmx_filename != nullptr) {
+            std::unordered_map<std::string, const char *> stems;
+            for (const char *filename : config.input_filenames) {
+                auto inserted = stems.insert(std::make_pair(input_output_filename("%s", filename), filename));
+                if (!inserted.second) {
+                    printf("\"%s\" and \"%s\" have the same name, so their tilemap and TMX files would overwrite each other\n",
+                           inserted.first->second, filename);
+                    exit(1);
+                }
+            }
         }
     }
 
@@ -419,14 +767,22 @@ Config parse_commandline_opts(int argc, char **argv) {
         printf("Warning: output changed to binary because compression was enabled.\n");
         config.output_bin = true;
     }
+    if (config.tilemap_filename != nullptr) {
+        int maxPalettes = config.tilemapOutputFormat == TILEMAP_FORMAT_SMS ? SMS_TILEMAP_MAX_PALETTES : GEN_TILEMAP_MAX_PALETTES;
+        if (config.numPalettes > maxPalettes) {
+            printf("Warning: the %s tilemap format can only select %d palettes. Tiles using later palettes will not be marked correctly.\n",
+                   config.tilemapOutputFormat == TILEMAP_FORMAT_SMS ? "sms" : "gen", maxPalettes);
+        }
+    }
 
     return config;
 }
 
-void write_tiles_to_png_image(const char *output_image_filename, const std::vector<std::vector<Color>> &palettes, std::vector<Tile *> *tiles) {
+void write_tiles_to_png_image(const Config &config, const char *output_image_filename, const std::vector<std::vector<Color>> &palettes,
+                              const TileStore &tiles) {
     int output_width = 16;
-    int output_height = (int)tiles->size() / output_width;
-    if (tiles->size() % output_width != 0) {
+    int output_height = (int)tiles.size() / output_width;
+    if (tiles.size() % output_width != 0) {
         output_height++;
     }
 
@@ -435,13 +791,14 @@ void write_tiles_to_png_image(const char *output_image_filename, const std::vect
 
     unsigned char *pixels = (unsigned char *) malloc(output_width * output_height);
     memset(pixels, 0, output_width * output_height);
-    int size = (int) tiles->size();
+    int size = (int) tiles.size();
 
     for (int i = 0; i < size; i++) {
         unsigned char *ptr = &pixels[(i / NUM_TILE_COLS_IN_PNG_IMAGE) * output_width * TILE_HEIGHT +
                             (i % NUM_TILE_COLS_IN_PNG_IMAGE) * TILE_WIDTH];
-        Tile *tile = tiles->at(i);
-        unsigned char *tile_data_ptr = tile->data;
+        unsigned char tile_data[NUM_PIXELS_IN_TILE];
+        tile_unpack_planes(tiles.planes(i), tile_data);
+        unsigned char *tile_data_ptr = tile_data;
         for (int j = 0; j < TILE_WIDTH; j++) {
             memcpy(ptr, tile_data_ptr, TILE_WIDTH);
             tile_data_ptr += TILE_WIDTH;
@@ -449,11 +806,13 @@ void write_tiles_to_png_image(const char *output_image_filename, const std::vect
         }
     }
 
-    write_png_file(output_image_filename, output_width, output_height, pixels, palettes);
+    write_png_file(config, output_image_filename, output_width, output_height, pixels, palettes);
+    free(pixels);
 }
 
-void write_tiles(const Config &config, const char *filename, std::vector<Tile *> *tiles) {
-    int size = (int) tiles->size();
+// Writes tiles [firstTile, tiles.size()).
+void write_tiles(const Config &config, const char *filename, const TileStore &tiles, uint32_t firstTile) {
+    int size = (int) tiles.size();
 
     std::ofstream out;
     out.open(filename, config.output_bin ?
@@ -461,8 +820,8 @@ void write_tiles(const Config &config, const char *filename, std::vector<Tile *>
     // the binary output buffer
     std::vector<uint8_t> outbuf;
 
-    for (int i = 0; i < size; i++) {
-        Tile *tile = tiles->at(i);
+    for (int i = (int) firstTile; i < size; i++) {
+        const uint64_t *planes = tiles.planes(i);
         char buf[32];
         if (!config.output_bin) {
             snprintf(buf, 32, "%03X", i + config.tile_start_offset);
@@ -471,13 +830,10 @@ void write_tiles(const Config &config, const char *filename, std::vector<Tile *>
         }
 
         if (config.tileOutputFormat == TILE_FORMAT_PLANAR) {
+            // The tile's bitplanes already hold the planar bytes.
             for (int y = 0; y < TILE_HEIGHT; y++) {
                 for (int p = 0; p < 4; p++) {
-                    uint8_t byte = 0;
-                    for (int x = 0; x < TILE_WIDTH; x++) {
-                        uint8_t pixel = tile->data[y * TILE_WIDTH + x];
-                        byte |= ((pixel >> p & 1) << (7 - x));
-                    }
+                    uint8_t byte = (uint8_t) (planes[p] >> (y * 8));
                     if (!config.output_bin) {
                         snprintf(buf, 32, "%02X", byte);
                         out << " $" << buf;
@@ -486,8 +842,10 @@ void write_tiles(const Config &config, const char *filename, std::vector<Tile *>
                 }
             }
         } else if (config.tileOutputFormat == TILE_FORMAT_CHUNKY) {
+            unsigned char data[NUM_PIXELS_IN_TILE];
+            tile_unpack_planes(planes, data);
             for (int j = 0; j < NUM_PIXELS_IN_TILE; j += 2) {
-                uint8_t outbyte = (uint8_t) (tile->data[j + 1] & 0xF) | ((uint8_t) (tile->data[j] & 0xF) << 4);
+                uint8_t outbyte = (uint8_t) (data[j + 1] & 0xF) | ((uint8_t) (data[j] & 0xF) << 4);
                 if (!config.output_bin) {
                     snprintf(buf, 32, "%02X", outbyte);
                     out << " $" << buf;
@@ -505,7 +863,7 @@ void write_tiles(const Config &config, const char *filename, std::vector<Tile *>
     if (config.compress) {
         uint8_t* comp_dat = (uint8_t*)malloc(orig_sz);
 
-        int comp_sz = PSGaiden_compressTiles(outbuf.data(), size, comp_dat, orig_sz);
+        int comp_sz = PSGaiden_compressTiles(outbuf.data(), size - firstTile, comp_dat, orig_sz);
 
         if (!config.quiet) {
             std::cout << "Compressed tile data from " << orig_sz << " bytes to " << comp_sz
@@ -528,6 +886,23 @@ uint8_t convert_colour_channel_to_2bit(uint8_t c) {
     return 3;
 }
 
+// The colour the -pal format outputs for color, as one comparable value.
+uint32_t hardware_colour(const Config &config, const Color &color) {
+    switch (config.paletteOutputFormat) {
+        case SMS:
+        case SMS_CL123:
+            return convert_colour_channel_to_2bit(color.red)
+                | (convert_colour_channel_to_2bit(color.green) << 2)
+                | (convert_colour_channel_to_2bit(color.blue) << 4);
+        case GG:
+            return (color.red >> 4) | (color.green >> 4) << 4 | (color.blue >> 4) << 8;
+        case GEN:
+            return ((color.red >> 4) & 0xE) | ((color.green >> 4) & 0xE) << 4 | ((color.blue >> 4) & 0xE) << 8;
+        default:
+            return color.red | color.green << 8 | color.blue << 16;
+    }
+}
+
 void write_sms_palette_file(const Config& config, const std::vector<std::vector<Color>> &palettes) {
     std::ofstream out;
     out.open(config.palette_filename, config.output_bin ?
@@ -535,7 +910,7 @@ void write_sms_palette_file(const Config& config, const std::vector<std::vector<
 
     for (auto pal : palettes) {
         if (!config.output_bin) out << ".db";
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) pal.size(); i++) {
             uint8_t c = (convert_colour_channel_to_2bit((uint8_t) pal[i].red)
                        | (convert_colour_channel_to_2bit((uint8_t) pal[i].green) << 2)
                        | (convert_colour_channel_to_2bit((uint8_t) pal[i].blue) << 4));
@@ -560,7 +935,7 @@ void write_gg_palette_file(const Config& config, const std::vector<std::vector<C
     for (const auto &palette : palettes) {
         if (!config.output_bin) out << ".dw";
 
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) palette.size(); i++) {
             uint16_t c = ((uint16_t) palette[i].red >> 4)
                        | (uint16_t) (palette[i].green >> 4) << 4
                        | (uint16_t) (palette[i].blue >> 4) << 8;
@@ -583,7 +958,7 @@ void write_gen_palette_file_txt(const char *filename, const std::vector<std::vec
     out << ".dw";
 
     for (const auto &palette : palettes) {
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) palette.size(); i++) {
             uint16_t c = (uint16_t)(((palette[i].red >> 4) & 0xE) << 0)
                 | (uint16_t)(((palette[i].green >> 4) & 0xE) << 4)
                 | (uint16_t)(((palette[i].blue >> 4) & 0xE) << 8);
@@ -603,7 +978,7 @@ void write_gen_palette_file_bin(const char *filename, const std::vector<std::vec
     out.open(filename, std::ofstream::binary);
 
     for (const auto &palette : palettes) {
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) palette.size(); i++) {
             uint16_t c = (uint16_t)(((palette[i].red >> 4) & 0xE) << 0)
                 | (uint16_t)(((palette[i].green >> 4) & 0xE) << 4)
                 | (uint16_t)(((palette[i].blue >> 4) & 0xE) << 8);
@@ -632,7 +1007,7 @@ void write_sms_cl123_palette_file(const Config& config, const std::vector<std::v
     out << ".db";
 
     for (const auto &palette : palettes) {
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) palette.size(); i++) {
             uint8_t r = convert_colour_channel_to_2bit((uint8_t)palette[i].red);
             uint8_t g = convert_colour_channel_to_2bit((uint8_t)palette[i].green);
             uint8_t b = convert_colour_channel_to_2bit((uint8_t)palette[i].blue);
@@ -653,7 +1028,7 @@ void write_gimp_palette_file(const Config& config, const std::vector<std::vector
     out << "#\n";
 
     for (const auto &palette : palettes) {
-        for (int i = 0; i < MAX_COLOURS; i++) {
+        for (int i = 0; i < (int) palette.size(); i++) {
             char buf[12];
             snprintf(buf, 12, "%3d %3d %3d", (int) palette[i].red, (int) palette[i].green, (int) palette[i].blue);
             out << buf << "   Untitled\n";
@@ -663,31 +1038,26 @@ void write_gimp_palette_file(const Config& config, const std::vector<std::vector
     out.close();
 }
 
-unsigned int get_tmx_tile_id(std::vector<Tile *> *tilemap, int index) {
-    Tile *t = tilemap->at(index);
+unsigned int get_tmx_tile_id(const std::vector<TilemapEntry> &tilemap, int index) {
+    const TilemapEntry &t = tilemap[index];
 
-    unsigned int id = t->original_tile != nullptr ? (unsigned int) t->original_tile->id : (unsigned int) t->id;
+    unsigned int id = t.tile;
     id++;
-    if (t->flipped_x) {
+    if (t.flipped_x) {
         id = id | TMX_FLIP_X_FLAG;
     }
-    if (t->flipped_y) {
+    if (t.flipped_y) {
         id = id | TMX_FLIP_Y_FLAG;
     }
 
     return id;
 }
 
-void write_tmx_file(const char *filename, Image *input_image, const std::vector<std::vector<Color>> &palettes, std::vector<Tile *> *tiles, std::vector<Tile *> *tilemap,
-                    TileSize tileSize) {
-    std::string tileset_filename = filename;
-
-    tileset_filename += ".png";
-
-    write_tiles_to_png_image(tileset_filename.c_str(), palettes, tiles);
-
-    int tilemap_width = input_image->width / TILE_WIDTH;
-    int tilemap_height = input_image->height / TILE_HEIGHT;
+// tileset_filename is the tileset image, already written.
+void write_tmx_file(const Config &config, const char *filename, const char *tileset_filename, unsigned int width,
+                    unsigned int height, const std::vector<TilemapEntry> &tilemap) {
+    int tilemap_width = width / TILE_WIDTH;
+    int tilemap_height = height / TILE_HEIGHT;
 
     std::ofstream out;
     out.open(filename);
@@ -705,9 +1075,9 @@ void write_tmx_file(const char *filename, Image *input_image, const std::vector<
     out << " <layer name=\"Bottom\" width=\"" << tilemap_width << "\" height=\"" << tilemap_height << "\">\n";
     out << "  <data encoding=\"csv\" >";
 
-    int total_tiles = (int)tilemap->size();
+    int total_tiles = (int)tilemap.size();
 
-    if (tileSize == TILE_8x8) {
+    if (config.tileSize == TILE_8x8) {
         for (int i = 0; i < total_tiles; i++) {
             unsigned int id = get_tmx_tile_id(tilemap, i);
 
@@ -721,7 +1091,7 @@ void write_tmx_file(const char *filename, Image *input_image, const std::vector<
                 out << "\n";
             }
         }
-    } else if (tileSize == TILE_8x16) {
+    } else if (config.tileSize == TILE_8x16) {
         for (int y = 0; y < tilemap_height; y++) {
             int i = (y / 2) * tilemap_width * 2 + (y % 2);
             for (int x = 0; x < tilemap_width; x++, i += 2) {
@@ -747,27 +1117,28 @@ void write_tmx_file(const char *filename, Image *input_image, const std::vector<
     out.close();
 }
 
-void write_sms_tilemap_file(const Config& config, std::vector<Tile *> *tilemap, int width) {
+void write_sms_tilemap_file(const Config& config, const char *filename, const std::vector<TilemapEntry> &tilemap,
+                            int width) {
     std::ofstream out;
-    out.open(config.tilemap_filename, config.output_bin ?
+    out.open(filename, config.output_bin ?
         std::ofstream::binary : std::ofstream::out);
     std::vector<uint16_t> outbuf;
 
     if (!config.output_bin) out << ".dw";
     int height = 1;
 
-    int total_tiles = (int)tilemap->size();
+    int total_tiles = (int)tilemap.size();
     for (int i = 0; i < total_tiles; i++) {
-        Tile *t = tilemap->at(i);
+        const TilemapEntry &t = tilemap[i];
 
-        uint16_t id = t->original_tile != nullptr ? (uint16_t) t->original_tile->id : (uint16_t) t->id;
-        int palIdx = t->original_tile != nullptr ? t->original_tile->palette_index : t->palette_index;
+        uint16_t id = (uint16_t) t.tile;
+        int palIdx = t.palette;
         id += config.tile_start_offset;
 
-        if (t->flipped_x) {
+        if (t.flipped_x) {
             id = id | TILEMAP_SMS_H_FLIP_FLAG;
         }
-        if (t->flipped_y) {
+        if (t.flipped_y) {
             id = id | TILEMAP_SMS_V_FLIP_FLAG;
         }
 
@@ -818,27 +1189,28 @@ void write_sms_tilemap_file(const Config& config, std::vector<Tile *> *tilemap,
     out.close();
 }
 
-void write_gen_tilemap_file(const Config& config, std::vector<Tile *> *tilemap, int width) {
+void write_gen_tilemap_file(const Config& config, const char *filename, const std::vector<TilemapEntry> &tilemap,
+                            int width) {
     std::ofstream out;
-    out.open(config.tilemap_filename, config.output_bin ?
+    out.open(filename, config.output_bin ?
         std::ofstream::binary : std::ofstream::out);
     std::vector<uint16_t> outbuf;
 
     if (!config.output_bin) out << ".dw";
     int height = 1;
 
-    int total_tiles = (int)tilemap->size();
+    int total_tiles = (int)tilemap.size();
     for (int i = 0; i < total_tiles; i++) {
-        Tile *t = tilemap->at(i);
+        const TilemapEntry &t = tilemap[i];
 
-        uint16_t id = t->original_tile != nullptr ? (uint16_t) t->original_tile->id : (uint16_t) t->id;
-        int palIdx = t->original_tile != nullptr ? t->original_tile->palette_index : t->palette_index;
+        uint16_t id = (uint16_t) t.tile;
+        int palIdx = t.palette;
         id += config.tile_start_offset;
 
-        if (t->flipped_x) {
+        if (t.flipped_x) {
             id = id | TILEMAP_GEN_H_FLIP_FLAG;
         }
-        if (t->flipped_y) {
+        if (t.flipped_y) {
             id = id | TILEMAP_GEN_V_FLIP_FLAG;
         }
 
@@ -895,123 +1267,415 @@ void write_gen_tilemap_file(const Config& config, std::vector<Tile *> *tilemap,
     out.close();
 }
 
-void write_tilemap_file(const Config& config, std::vector<Tile *> *tilemap, int width) {
+void write_tilemap_file(const Config& config, const char *filename, const std::vector<TilemapEntry> &tilemap,
+                        int width) {
     if (config.tilemapOutputFormat == TILEMAP_FORMAT_SMS) {
-        write_sms_tilemap_file(config, tilemap, width);
+        write_sms_tilemap_file(config, filename, tilemap, width);
     } else if (config.tilemapOutputFormat == TILEMAP_FORMAT_GEN) {
-        write_gen_tilemap_file(config, tilemap, width);
+        write_gen_tilemap_file(config, filename, tilemap, width);
+    }
+}
+
+// The unique tiles found so far and the indexes used to dedup against them.
+struct Tileset {
+    TileStore tiles;
+    TileIndex index;
+    // Only filled when -maxdiff is set.
+    TileBkTree nearIndex;
+    // Reused by every nearIndex query. Queries only run on the thread that
+    // updates the index, so one buffer is enough.
+    std::vector<int> nearScratch;
+    // Tiles [0, numBaseTiles) came from -basetiles. They are not in index
+    // or nearIndex, see load_base_tiles.
+    uint32_t numBaseTiles;
+    // The palette of a PNG -basetiles image, whose tiles keep the PNG's
+    // indices until remap_png_base_tiles. Empty for binary base tiles.
+    std::vector<Color> basePngPalette;
+    int numLossyMerges;
+    long totalPixelError;
+
+    explicit Tileset(bool mirrored) : index(mirrored), numBaseTiles(0), numLossyMerges(0), totalPixelError(0) {}
+};
+
+uint32_t add_new_tile(const Config &config, Tileset *tileset, const TileKey &key, const Tile &tile,
+                      const ColorSet &colors) {
+    uint32_t id = tileset->tiles.add(tile, colors);
+    tileset->index.add(key, id);
+    if (config.maxDiff > 0) {
+        tileset->nearIndex.add(tileset->tiles, id);
     }
+    return id;
 }
 
-Tile *find_duplicate(Tile *tile, std::vector<Tile *> *tiles) {
-    for (auto t : *tiles) {
-        if (tile->isDataEqual(t)) {
-            return t;
+// Looks for an existing tile at most config.maxDiff pixels away from the tile,
+// trying each orientation in the same order as exact matching.
+bool find_near_tile(const Config &config, Tileset *tileset, const Tile &tile, TilemapEntry *entry, int *distance) {
+    uint64_t flipped[NUM_TILE_TRANSFORMS][TILE_NUM_PLANES];
+    memcpy(flipped[TILE_TRANSFORM_NONE], tile.planes, sizeof(tile.planes));
+    int numTransforms = 1;
+    if (config.mirror) {
+        tile_flip_x(tile.planes, flipped[TILE_TRANSFORM_FLIP_X]);
+        tile_flip_y(tile.planes, flipped[TILE_TRANSFORM_FLIP_Y]);
+        tile_flip_xy(tile.planes, flipped[TILE_TRANSFORM_FLIP_XY]);
+        numTransforms = NUM_TILE_TRANSFORMS;
+    }
+
+    int best = -1;
+    for (int transform = 0; transform < numTransforms; transform++) {
+        // Stop looking once a closer match is impossible.
+        int radius = best < 0 ? config.maxDiff : best - 1;
+        uint32_t id;
+        int d = tileset->nearIndex.findNearest(tileset->tiles, flipped[transform], radius, &id, &tileset->nearScratch);
+        if (d >= 0) {
+            best = d;
+            entry->tile = id;
+            entry->flipped_x = transform == TILE_TRANSFORM_FLIP_X || transform == TILE_TRANSFORM_FLIP_XY;
+            entry->flipped_y = transform == TILE_TRANSFORM_FLIP_Y || transform == TILE_TRANSFORM_FLIP_XY;
+        }
+        if (best == 0) {
+            break;
         }
     }
 
-    return nullptr;
+    *distance = best;
+    return best >= 0;
 }
 
-Tile *createTile(Image *image, int x, int y, std::vector<Tile *> *tiles, bool mirrored) {
-    Tile *tile = new Tile(0, image, x, y);
-    if (!tile->validateColorUsage()) {
-        printf("Warning: Too many colors used in tile (%d, %d)\n", x, y);
-    }
+void add_base_tile(Tileset *tileset, const Tile &tile) {
+    TileAnalysis analysis;
+    tile.analyze(&analysis);
+    tileset->tiles.add(tile, analysis.colors);
+}
 
-    tile->original_tile = find_duplicate(tile, tiles);
-    if (tile->original_tile) {
-        tile->is_duplicate = true;
+// Seeds the tileset with the tiles in config.base_tiles_filename, which is
+// either a PNG tile image or binary tile data in config.tileOutputFormat.
+// Base tiles hold VRAM data, entries of whichever palette a cell selects,
+// while image tiles hold image palette indices until palettes are assigned.
+// So base tiles stay out of the extraction indexes and are matched by
+// merge_remapped_duplicates instead. Their ids are their position in the
+// file.
+bool load_base_tiles(const Config &config, Tileset *tileset) {
+    const char *filename = config.base_tiles_filename;
+    MappedFile file;
+    if (file.open(filename) != 0) {
+        printf("Failed to open base tiles file:  %s\n", filename);
+        return false;
     }
 
-    if (mirrored && !tile->is_duplicate) {
-        Tile *flipped = tile->flipX();
-        tile->original_tile = find_duplicate(flipped, tiles);
-        delete flipped;
-        if (tile->original_tile) {
-            tile->flipped_x = true;
-            tile->is_duplicate = true;
-        } else {
-            flipped = tile->flipY();
-            tile->original_tile = find_duplicate(flipped, tiles);
-            delete flipped;
-            if (tile->original_tile) {
-                tile->flipped_y = true;
-                tile->is_duplicate = true;
+    static const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (file.size() >= sizeof(PNG_SIGNATURE) && memcmp(file.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0) {
+        file.close();
+        Image *image = read_png_file(config, filename, true);
+        if (image == nullptr) {
+            return false;
+        }
+        if (image->width % TILE_WIDTH != 0 || image->height % TILE_HEIGHT != 0) {
+            printf("Base tiles image size must be a multiple of %d.\n", TILE_WIDTH);
+            delete image;
+            return false;
+        }
+        for (unsigned int y = 0; y < image->height; y += TILE_HEIGHT) {
+            for (unsigned int x = 0; x < image->width; x += TILE_WIDTH) {
+                add_base_tile(tileset, Tile(image, x, y));
+            }
+        }
+        tileset->basePngPalette = image->palette;
+        delete image;
+    } else {
+        const size_t tileBytes = NUM_PIXELS_IN_TILE / 2;
+        if (file.size() % tileBytes != 0) {
+            printf("Base tiles file size must be a multiple of %d bytes.\n", (int) tileBytes);
+            return false;
+        }
+        for (size_t offset = 0; offset < file.size(); offset += tileBytes) {
+            const unsigned char *src = file.data() + offset;
+            Tile tile;
+            if (config.tileOutputFormat == TILE_FORMAT_PLANAR) {
+                for (int y = 0; y < TILE_HEIGHT; y++) {
+                    for (int p = 0; p < 4; p++) {
+                        tile.planes[p] |= (uint64_t) *src++ << (y * 8);
+                    }
+                }
             } else {
-                flipped = tile->flipXY();
-                tile->original_tile = find_duplicate(flipped, tiles);
-                delete flipped;
-                if (tile->original_tile) {
-                    tile->flipped_x = true;
-                    tile->flipped_y = true;
-                    tile->is_duplicate = true;
+                unsigned char pixels[NUM_PIXELS_IN_TILE];
+                for (int j = 0; j < NUM_PIXELS_IN_TILE; j += 2, src++) {
+                    pixels[j] = *src >> 4;
+                    pixels[j + 1] = *src & 0xF;
                 }
+                tile_pack_planes(pixels, TILE_WIDTH, tile.planes);
             }
+            add_base_tile(tileset, tile);
         }
     }
 
-    return tile;
+    tileset->numBaseTiles = tileset->tiles.size();
+    if (!config.quiet) {
+        printf("Loaded %d base tiles from \"%s\"\n", (int) tileset->numBaseTiles, filename);
+    }
+    return true;
 }
 
-void add_new_tile(std::vector<Tile *> *tiles, Tile *tile) {
-    tile->id = (uint16_t)tiles->size();
-    tiles->push_back(tile);
+// An input image opened for decoding. Its pixels are decoded a band at a
+// time as the tiles are extracted, so are never all in memory at once.
+typedef struct {
+    MappedFile file;
+    PngTileReader reader;
+    // Applied to every decoded pixel when remapped is set, see -foldColors.
+    unsigned char remap[256];
+    bool remapped;
+} InputImage;
+
+// A tile cut out of the image together with its analysis and dedup key.
+typedef struct {
+    Tile tile;
+    TileAnalysis analysis;
+    TileKey key;
+} ExtractedTile;
+
+// y is the tile's row in the whole image; band holds the rows from bandY.
+void extract_tile(Image *band, int x, int y, int bandY, const TileIndex &tileIndex, ExtractedTile *out) {
+    out->tile = Tile(band, x, y - bandY);
+    out->tile.tilemapY = y;
+    out->tile.analyze(&out->analysis);
+    out->key = tileIndex.makeKey(out->tile, out->analysis);
 }
 
-std::vector<std::set<int>> combineSupersets(std::vector<std::set<int>> sets) {
-    bool merged = true;
+// Extracts the tiles of tile rows [firstRow, lastRow) in tilemap order.
+// band holds the pixels from tile row bandRow down. Only reads the band and
+// the index, so rows can be extracted concurrently.
+void extract_tile_rows(const Config &config, Image *band, unsigned int bandRow, const TileIndex &tileIndex,
+                       unsigned int firstRow, unsigned int lastRow, ExtractedTile *out) {
+    unsigned int rowHeight = config.tileSize == TILE_8x16 ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+    int bandY = (int) (bandRow * rowHeight);
+    for (unsigned int row = firstRow; row < lastRow; row++) {
+        for (unsigned int x = 0; x < band->width; x += TILE_WIDTH) {
+            if (config.tileSize == TILE_8x8) {
+                extract_tile(band, x, row * TILE_HEIGHT, bandY, tileIndex, out++);
+            } else if (config.tileSize == TILE_8x16) {
+                extract_tile(band, x, row * TILE_HEIGHT * 2, bandY, tileIndex, out++);
+                extract_tile(band, x, row * TILE_HEIGHT * 2 + TILE_HEIGHT, bandY, tileIndex, out++);
+            }
+        }
+    }
+}
 
-    while (merged) {
-        merged = false;
-        for (size_t i = 0; i < sets.size(); ++i) {
-            for (size_t j = i + 1; j < sets.size(); ++j) {
-                const auto& a = sets[i];
-                const auto& b = sets[j];
+TilemapEntry createTile(const Config &config, const ExtractedTile &extracted, Tileset *tileset) {
+    if (extracted.analysis.numColors > config.paletteSize) {
+        printf("Warning: Too many colors used in tile (%d, %d)\n", extracted.tile.tilemapX, extracted.tile.tilemapY);
+    }
 
-                bool aContainsB = std::includes(a.begin(), a.end(), b.begin(), b.end());
-                bool bContainsA = std::includes(b.begin(), b.end(), a.begin(), a.end());
+    // A single probe finds the tile in any orientation when mirroring is enabled.
+    TilemapEntry entry;
+    bool is_duplicate = tileset->index.find(extracted.key, &entry.tile, &entry.flipped_x, &entry.flipped_y);
 
-                if (aContainsB || bContainsA) {
-                    // Keep the superset (or either if equal), remove the other
-                    if (bContainsA) {
-                        sets[i] = sets[j]; // b is superset, promote to i
-                    }
-                    sets.erase(sets.begin() + j);
-                    merged = true;
-                    break; // Restart inner loop after mutation
+    int distance;
+    if (!is_duplicate && config.remove_dups && config.maxDiff > 0 &&
+        find_near_tile(config, tileset, extracted.tile, &entry, &distance)) {
+        tileset->numLossyMerges++;
+        tileset->totalPixelError += distance;
+        return entry;
+    }
+
+    if (!is_duplicate || !config.remove_dups) {
+        uint32_t id = add_new_tile(config, tileset, extracted.key, extracted.tile, extracted.analysis.colors);
+        if (!is_duplicate) {
+            entry.tile = id;
+            entry.flipped_x = false;
+            entry.flipped_y = false;
+        }
+    }
+
+    return entry;
+}
+
+// Cuts the image into tiles and dedups them into tiles/tilemap.
+// The image is decoded a batch of tile rows at a time, and each batch is
+// released once its tiles are in the tileset. Extraction, canonicalisation
+// and hashing run on the pool's threads, each taking a band of the batch's
+// rows. The index is then probed and updated on one thread in tilemap
+// order, so tile ids and flips do not depend on the number of threads.
+// Returns false if the image fails to decode.
+bool extract_tiles(const Config &config, InputImage *input, WorkerPool *pool, Tileset *tileset,
+                   std::vector<TilemapEntry> *tilemap) {
+    PngTileReader &reader = input->reader;
+    unsigned int rowHeight = config.tileSize == TILE_8x16 ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+    unsigned int numRows = reader.height() / rowHeight;
+    unsigned int tilesPerRow = (reader.width() / TILE_WIDTH) * (rowHeight / TILE_HEIGHT);
+    unsigned int numThreads = pool->size();
+    unsigned int rowsPerBatch = numThreads * TILE_ROWS_PER_BAND;
+    std::vector<ExtractedTile> batch((std::size_t)std::min(rowsPerBatch, numRows) * tilesPerRow);
+    Image band;
+
+    for (unsigned int firstRow = 0; firstRow < numRows; firstRow += rowsPerBatch) {
+        unsigned int lastRow = std::min(firstRow + rowsPerBatch, numRows);
+        unsigned error = reader.readBlockRows((lastRow - firstRow) * rowHeight / IMAGE_BLOCK_SIZE, &band);
+        if (error) {
+            std::cout << "[read_png_file] decoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
+            return false;
+        }
+        if (input->remapped) {
+            for (unsigned char &pixel : band.pixels) {
+                pixel = input->remap[pixel];
+            }
+        }
+
+        auto extract_band = [&](unsigned int bandFirst, unsigned int bandLast) {
+            ExtractedTile *out = &batch[(std::size_t)(bandFirst - firstRow) * tilesPerRow];
+            extract_tile_rows(config, &band, firstRow, tileset->index, bandFirst, bandLast, out);
+        };
+
+        if (numThreads == 1) {
+            extract_band(firstRow, lastRow);
+        } else {
+            unsigned int numBands = (lastRow - firstRow + TILE_ROWS_PER_BAND - 1) / TILE_ROWS_PER_BAND;
+            pool->run(numBands, [&](unsigned int b) {
+                unsigned int bandFirst = firstRow + b * TILE_ROWS_PER_BAND;
+                extract_band(bandFirst, std::min(bandFirst + TILE_ROWS_PER_BAND, lastRow));
+            });
+        }
+
+        std::size_t numExtracted = (std::size_t)(lastRow - firstRow) * tilesPerRow;
+        for (std::size_t i = 0; i < numExtracted; i++) {
+            tilemap->push_back(createTile(config, batch[i], tileset));
+        }
+    }
+    return true;
+}
+
+// Reduces sets to its maximal sets, dropping duplicates and every set that is
+// contained in another. The result is in the order the original pairwise
+// merge produced: walking the list, each set not already covered by an
+// earlier result grows into the first later strict superset, repeatedly.
+// Supersets and subsets are found with a per-colour bitmap over the distinct
+// sets, so each query is a handful of word-wide ANDs.
+std::vector<ColorSet> combineSupersets(const std::vector<ColorSet> &sets) {
+    // Distinct sets in order of first appearance.
+    std::vector<ColorSet> distinct;
+    std::unordered_map<ColorSet, uint32_t, ColorSetHash> seen;
+    for (const ColorSet &set : sets) {
+        if (seen.insert(std::make_pair(set, (uint32_t) distinct.size())).second) {
+            distinct.push_back(set);
+        }
+    }
+
+    size_t numSets = distinct.size();
+    size_t numWords = (numSets + 63) / 64;
+    // Word w of column c has bit b set when distinct[w * 64 + b] contains colour c.
+    std::vector<uint64_t> columns(COLOR_SET_BITS * numWords, 0);
+    for (size_t i = 0; i < numSets; i++) {
+        for (int color : distinct[i].colors()) {
+            columns[color * numWords + i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    std::vector<uint64_t> allSets(numWords, ~0ULL);
+    if (numSets % 64 != 0) {
+        allSets[numWords - 1] = (1ULL << (numSets % 64)) - 1;
+    }
+
+    std::vector<ColorSet> result;
+    std::vector<uint64_t> covered(numWords, 0);
+    std::vector<uint64_t> matches(numWords);
+    for (size_t i = 0; i < numSets; i++) {
+        if ((covered[i / 64] >> (i % 64)) & 1) {
+            continue;
+        }
+
+        // Any superset of set i lies after it, or set i would be covered.
+        size_t current = i;
+        for (;;) {
+            matches = allSets;
+            for (int color : distinct[current].colors()) {
+                const uint64_t *column = &columns[color * numWords];
+                for (size_t w = 0; w < numWords; w++) {
+                    matches[w] &= column[w];
+                }
+            }
+            matches[current / 64] &= ~(1ULL << (current % 64));
+
+            size_t next = numSets;
+            for (size_t w = 0; w < numWords; w++) {
+                if (matches[w] != 0) {
+                    next = w * 64 + ColorSet::countTrailingZeros(matches[w]);
+                    break;
+                }
+            }
+            if (next == numSets) {
+                break;
+            }
+            current = next;
+        }
+
+        // Everything using no colour outside the maximal set is covered by it.
+        const ColorSet &maximal = distinct[current];
+        matches = allSets;
+        for (int color = 0; color < COLOR_SET_BITS; color++) {
+            if (!maximal.contains(color)) {
+                const uint64_t *column = &columns[color * numWords];
+                for (size_t w = 0; w < numWords; w++) {
+                    matches[w] &= ~column[w];
                 }
             }
-            if (merged) break;
         }
+        for (size_t w = 0; w < numWords; w++) {
+            covered[w] |= matches[w];
+        }
+        result.push_back(maximal);
     }
 
-    return sets;
+    return result;
 }
 
-std::vector<std::vector<Color>> createPalettes(const Config &config, Image *image, std::vector<Tile *> &tiles) {
-    std::vector<std::set<int>> supersets;
+// Base tiles (below firstTile) hold VRAM data and are left alone.
+std::vector<std::vector<Color>> createPalettes(const Config &config, const std::vector<Color> &imagePalette,
+                                               TileStore &tiles, uint32_t firstTile) {
+    std::vector<ColorSet> supersets;
     std::vector<std::vector<Color>> palettes;
 
     if (config.generateNewPal) {
         //generate optimal palettes
-        for (Tile *tile : tiles) {
-            std::set<int> colors;
-            for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
-                colors.insert(tile->data[i]);
+        for (uint32_t t = firstTile; t < tiles.size(); t++) {
+            supersets.push_back(tiles.colors(t));
+        }
+        const std::vector<ColorSet> inputs = combineSupersets(supersets);
+        try {
+            PaletteSearchOptions options;
+            options.timeoutMs = config.palTimeoutMs;
+            options.mode = config.palPortfolio ? PALETTE_SEARCH_PORTFOLIO : PALETTE_SEARCH_DEFAULT;
+            options.deterministic = config.palSeeded;
+            options.seed = config.palSeed;
+            PaletteSearchResult result;
+            supersets = reduceToNBuckets(inputs, config.numPalettes, config.paletteSize, options, &result);
+            if (config.palPortfolio && !config.quiet) {
+                printf("Palettes found by %s after %lu steps\n", result.strategy, result.nodes);
             }
-            supersets.push_back(colors);
+        } catch (const PaletteTimeoutError &e) {
+            printf("Error: %s. Raise -palTimeout, use more palettes (-numPals) or fewer colours per tile.\n", e.what());
+            exit(1);
+        } catch (const std::exception &e) {
+            printf("Error: could not generate palettes: %s\n", e.what());
+            exit(1);
         }
-        supersets = combineSupersets(supersets);
-        supersets = reduceToNBuckets(supersets, config.numPalettes, MAX_COLOURS);
         // std::cout << "num reduced sets" << supersets.size() << std::endl;
+        if (config.palOptimize) {
+            PaletteOptimizeResult optimized;
+            supersets = optimizePalettes(inputs, supersets, tiles, firstTile, config.paletteSize, config.mirror,
+                                         config.palSwapDupes && config.remove_dups, &optimized);
+            if (!config.quiet) {
+                printf("Optimized palettes (%lu of %lu moves kept): %d -> %d tiles, %d -> %d free palette entries\n",
+                       optimized.movesKept, optimized.movesTried,
+                       (int) optimized.initialTiles, (int) optimized.finalTiles,
+                       (int) optimized.initialFree, (int) optimized.finalFree);
+            }
+        }
     } else {
         // use existing palettes from input image
+        int size = config.paletteSize;
         for (int palIdx = 0; palIdx < config.numPalettes; palIdx++) {
-            std::set<int> palette;
-            int numColors = image->palette.size() >= (palIdx+1) * MAX_COLOURS
-                ? MAX_COLOURS
-                : image->palette.size() - palIdx * MAX_COLOURS;
+            ColorSet palette;
+            int numColors = (int) imagePalette.size() >= (palIdx+1) * size
+                ? size
+                : (int) imagePalette.size() - palIdx * size;
             if (numColors < 0) {
                 numColors = 0;
             }
@@ -1019,18 +1683,41 @@ std::vector<std::vector<Color>> createPalettes(const Config &config, Image *imag
                 if (palIdx > 0 && j == 0) {
                     palette.insert(0); // use the base bg pal entry for sprite palettes
                 } else {
-                    palette.insert(palIdx * MAX_COLOURS + j);
+                    palette.insert(palIdx * size + j);
                 }
             }
             supersets.push_back(palette);
+        }
 
-            // force any tile using the sprite palette to use the base bg pal entry.
-            for (Tile *tile : tiles) {
+        // force any tile using the sprite palette to use the base bg pal entry.
+        ColorSet baseEntries;
+        for (int c = size; c < COLOR_SET_BITS; c += size) {
+            baseEntries.insert(c);
+        }
+        for (uint32_t t = firstTile; t < tiles.size(); t++) {
+            ColorSet &colors = tiles.colors(t);
+            if (!colors.intersects(baseEntries)) {
+                continue;
+            }
+            colors.erase(baseEntries);
+            colors.insert(0);
+
+            uint64_t *planes = tiles.planes(t);
+            if (size == MAX_COLOURS) {
+                // A pixel is a multiple of 16 when its low four planes are clear.
+                uint64_t baseEntry = ~(planes[0] | planes[1] | planes[2] | planes[3]);
+                for (int p = 4; p < TILE_NUM_PLANES; p++) {
+                    planes[p] &= ~baseEntry;
+                }
+            } else {
+                unsigned char data[NUM_PIXELS_IN_TILE];
+                tile_unpack_planes(planes, data);
                 for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
-                    if (tile->data[i] % MAX_COLOURS == 0) {
-                        tile->data[i] = 0;
+                    if (data[i] % size == 0) {
+                        data[i] = 0;
                     }
                 }
+                tile_pack_planes(data, TILE_WIDTH, planes);
             }
         }
     }
@@ -1039,99 +1726,293 @@ std::vector<std::vector<Color>> createPalettes(const Config &config, Image *imag
         std::vector<Color> palette;
         const char *sep = " ";
         if (!config.quiet) std::cout << "Palette: ";
-        for (const int &value : set) {
+        for (const int &value : set.colors()) {
             if (!config.quiet) std::cout << sep << value; sep = ", ";
-            palette.push_back(image->palette[value]);
+            palette.push_back(imagePalette[value]);
         }
-        // Output palettes must always be 16 colors in size.
+        // Output palettes must always be -palSize colors in size.
         // Pad out with base palette color if required.
-        if (palette.size() < MAX_COLOURS) {
-            for (int i = palette.size(); i < MAX_COLOURS; i++) {
-                palette.push_back(image->palette[0]);
+        if ((int) palette.size() < config.paletteSize) {
+            for (int i = palette.size(); i < config.paletteSize; i++) {
+                palette.push_back(imagePalette[0]);
             }
         }
         if (!config.quiet) std::cout << std::endl;
         palettes.push_back(palette);
     }
-    for (Tile *tile : tiles) {
-        tile->setPalette(supersets);
+    PaletteMap paletteMap(supersets);
+    for (uint32_t t = firstTile; t < tiles.size(); t++) {
+        Tile tile = tiles.get(t);
+        tile.setPalette(paletteMap, tiles.colors(t));
+        tiles.set(t, tile);
     }
     return palettes;
 }
 
-int process_file(const Config &config) {
+// An input image's size and its tilemap into the shared tileset.
+typedef struct {
+    const char *filename;
+    unsigned int width, height;
+    std::vector<TilemapEntry> tilemap;
+} ConvertedImage;
+
+// Fills remap to repoint each palette entry to the first earlier entry with
+// the same hardware colour. Without -generateNewPal an entry only folds into
+// its own -palSize block, and never into the first entry of a later block,
+// which is replaced by entry 0. Returns the number of entries folded away.
+int fold_hardware_colours(const Config &config, const std::vector<Color> &palette, unsigned char *remap) {
+    int numFolded = 0;
+    int size = config.paletteSize;
+    for (size_t i = 0; i < 256; i++) {
+        remap[i] = (unsigned char) i;
+        if (i >= palette.size()) {
+            continue;
+        }
+        uint32_t colour = hardware_colour(config, palette[i]);
+        for (size_t j = 0; j < i; j++) {
+            if (!config.generateNewPal && (j / size != i / size || (j >= (size_t) size && j % size == 0))) {
+                continue;
+            }
+            if (hardware_colour(config, palette[j]) == colour) {
+                remap[i] = (unsigned char) j;
+                numFolded++;
+                break;
+            }
+        }
+    }
+    return numFolded;
+}
+
+InputImage *load_input_image(const Config &config, const char *filename) {
     // some extra verbosity
     if (!config.quiet) {
-        printf("Processing \"%s\"...\n", config.input_filename);
+        printf("Processing \"%s\"...\n", filename);
     }
 
-    Image *image = read_png_file(config, config.input_filename, config.quiet);
-    if (image == nullptr) {
-        printf("Failed to open file:  %s\n", config.input_filename);
-        return 1;
+    InputImage *input = new InputImage;
+    input->remapped = false;
+    if (!open_png_file(filename, &input->file, &input->reader)) {
+        printf("Failed to open file:  %s\n", filename);
+        delete input;
+        return nullptr;
     }
+    const PngTileReader &reader = input->reader;
 
-    if (image->width % TILE_WIDTH != 0) {
+    if (reader.width() % TILE_WIDTH != 0) {
         printf("Input image width must be a multiple of %d.\n", TILE_WIDTH);
         exit(1);
     }
 
-    if (config.tileSize == TILE_8x8 && image->height % TILE_HEIGHT != 0) {
+    if (config.tileSize == TILE_8x8 && reader.height() % TILE_HEIGHT != 0) {
         printf("Input image height must be a multiple of %d.\n", TILE_HEIGHT);
         exit(1);
     }
 
-    if (config.tileSize == TILE_8x16 && image->height % 16 != 0) {
+    if (config.tileSize == TILE_8x16 && reader.height() % 16 != 0) {
         printf("Input image height must be a multiple of 16 when 8x16 tile mode is selected.\n");
         exit(1);
     }
 
-    std::vector<Tile *> tilemap;
-    std::vector<Tile *> tiles;
+    if (config.foldColors) {
+        int numFolded = fold_hardware_colours(config, reader.palette(), input->remap);
+        input->remapped = numFolded > 0;
+        if (!config.quiet) {
+            printf("Folded %d palette entries into entries with the same hardware colour\n", numFolded);
+        }
+    }
 
-    if (config.tileSize == TILE_8x8) {
-        for (unsigned int y = 0; y < image->height; y += TILE_HEIGHT) {
-            for (unsigned int x = 0; x < image->width; x += TILE_WIDTH) {
-                Tile *tile = createTile(image, x, y, &tiles, config.mirror);
+    return input;
+}
 
-                if (!tile->is_duplicate || !config.remove_dups) {
-                    add_new_tile(&tiles, tile);
-                }
-                tilemap.push_back(tile);
+// Rewrites PNG base tiles as entries of the first output palette, matching
+// by colour since a PNG's own palette order is not preserved by every
+// encoder. A PNG index keeps its own entry if that has the same colour,
+// otherwise takes the first entry that does; unknown colours keep their low
+// four bits.
+void remap_png_base_tiles(Tileset *tileset, const std::vector<Color> &palette) {
+    const std::vector<Color> &pngPalette = tileset->basePngPalette;
+    unsigned char remap[256];
+    for (size_t i = 0; i < 256; i++) {
+        remap[i] = (unsigned char) (i & 0xF);
+        if (i >= pngPalette.size()) {
+            continue;
+        }
+        const Color &c = pngPalette[i];
+        auto sameColour = [&](size_t j) {
+            return j < palette.size() && palette[j].red == c.red && palette[j].green == c.green && palette[j].blue == c.blue;
+        };
+        if (sameColour(remap[i])) {
+            continue;
+        }
+        for (size_t j = 0; j < MAX_COLOURS; j++) {
+            if (sameColour(j)) {
+                remap[i] = (unsigned char) j;
+                break;
             }
         }
-    } else if (config.tileSize == TILE_8x16) {
-        for (unsigned int y = 0; y < image->height; y += TILE_HEIGHT * 2) {
-            for (unsigned int x = 0; x < image->width; x += TILE_WIDTH) {
-                Tile *tile = createTile(image, x, y, &tiles, config.mirror);
+    }
 
-                if (!tile->is_duplicate || !config.remove_dups) {
-                    add_new_tile(&tiles, tile);
-                }
-                tilemap.push_back(tile);
+    for (uint32_t t = 0; t < tileset->numBaseTiles; t++) {
+        unsigned char data[NUM_PIXELS_IN_TILE];
+        tile_unpack_planes(tileset->tiles.planes(t), data);
+        for (unsigned char &pixel : data) {
+            pixel = remap[pixel];
+        }
+        tile_pack_planes(data, TILE_WIDTH, tileset->tiles.planes(t));
+    }
+}
 
-                tile = createTile(image, x, y + TILE_HEIGHT, &tiles, config.mirror);
+// Once tiles hold palette-local pixels they can be matched against the base
+// tiles, and with -palSwapDupes the same shape drawn with different
+// palettes is the same tile data. Rebuilds the tileset from fresh indexes
+// over the remapped tiles, preferring a base tile, then the first copy of
+// an image tile, and repoints cells at the tile kept: flips compose and
+// each cell keeps its own palette. Base tiles are always kept so their ids
+// still match VRAM. Sets the number of image tiles replaced by base tiles
+// and, with -palSwapDupes, by other image tiles.
+void merge_remapped_duplicates(const Config &config, Tileset *tileset, std::vector<ConvertedImage> *converted,
+                               int *numBaseMatches, int *numPaletteSwaps) {
+    const TileStore &tiles = tileset->tiles;
+    bool mergeSwaps = config.palSwapDupes && config.remove_dups;
+    TileStore kept;
+    kept.reserve(tiles.size());
+    TileIndex baseIndex(config.mirror);
+    TileIndex index(config.mirror);
+    // Where each old tile went and how it is flipped relative to that tile.
+    std::vector<TilemapEntry> moved(tiles.size());
+    *numBaseMatches = 0;
+    *numPaletteSwaps = 0;
+
+    for (uint32_t t = 0; t < tiles.size(); t++) {
+        Tile tile = tiles.get(t);
+        TileAnalysis analysis;
+        tile.analyze(&analysis);
+        TileKey key = index.makeKey(tile, analysis);
+        TilemapEntry &entry = moved[t];
+        if (t >= tileset->numBaseTiles && baseIndex.find(key, &entry.tile, &entry.flipped_x, &entry.flipped_y)) {
+            (*numBaseMatches)++;
+        } else if (t >= tileset->numBaseTiles && mergeSwaps &&
+                   index.find(key, &entry.tile, &entry.flipped_x, &entry.flipped_y)) {
+            (*numPaletteSwaps)++;
+        } else {
+            entry.tile = kept.add(tile, tiles.colors(t));
+            entry.flipped_x = false;
+            entry.flipped_y = false;
+            (t < tileset->numBaseTiles ? baseIndex : index).add(key, entry.tile);
+        }
+    }
 
-                if (!tile->is_duplicate || !config.remove_dups) {
-                    add_new_tile(&tiles, tile);
-                }
-                tilemap.push_back(tile);
-            }
+    for (ConvertedImage &c : *converted) {
+        for (TilemapEntry &cell : c.tilemap) {
+            const TilemapEntry &to = moved[cell.tile];
+            cell.tile = to.tile;
+            cell.flipped_x = cell.flipped_x != to.flipped_x;
+            cell.flipped_y = cell.flipped_y != to.flipped_y;
+        }
+    }
+    tileset->tiles = kept;
+}
+
+bool same_palette(const std::vector<Color> &a, const std::vector<Color> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].red != b[i].red || a[i].green != b[i].green || a[i].blue != b[i].blue) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Converts every input image against one shared tileset. Each image is
+// decoded and tiled a band at a time, then released; only the first image's
+// palette is kept.
+int process_file(const Config &config) {
+    Tileset tileset(config.mirror);
+    TileStore &tiles = tileset.tiles;
+    std::vector<ConvertedImage> converted(config.input_filenames.size());
+    std::vector<Color> palette;
+    WorkerPool pool((unsigned int) std::max(1, config.numThreads));
+
+    for (size_t i = 0; i < config.input_filenames.size(); i++) {
+        InputImage *input = load_input_image(config, config.input_filenames[i]);
+        if (input == nullptr) {
+            return 1;
         }
+        const PngTileReader &reader = input->reader;
+
+        if (i == 0 && config.base_tiles_filename != nullptr && !load_base_tiles(config, &tileset)) {
+            delete input;
+            return 1;
+        }
+
+        ConvertedImage &out = converted[i];
+        out.filename = config.input_filenames[i];
+        out.width = reader.width();
+        out.height = reader.height();
+        out.tilemap.reserve((reader.width() / TILE_WIDTH) * (reader.height() / TILE_HEIGHT));
+
+        if (!extract_tiles(config, input, &pool, &tileset, &out.tilemap)) {
+            printf("Failed to open file:  %s\n", out.filename);
+            delete input;
+            return 1;
+        }
+
+        if (i == 0) {
+            palette = reader.palette();
+        } else if (!same_palette(palette, reader.palette())) {
+            printf("Warning: \"%s\" has a different palette to \"%s\". Colours are taken from \"%s\".\n",
+                   out.filename, converted[0].filename, converted[0].filename);
+        }
+        delete input;
     }
 
-    const std::vector<std::vector<Color>> palettes = createPalettes(config, image, tiles);
+    const std::vector<std::vector<Color>> palettes = createPalettes(config, palette, tiles, tileset.numBaseTiles);
+    for (ConvertedImage &c : converted) {
+        for (TilemapEntry &cell : c.tilemap) {
+            cell.palette = tiles.paletteIndex(cell.tile);
+        }
+    }
+    if (!tileset.basePngPalette.empty()) {
+        remap_png_base_tiles(&tileset, palettes[0]);
+    }
+    int numBaseMatches = 0;
+    int numPaletteSwaps = 0;
+    if (tileset.numBaseTiles > 0 || (config.palSwapDupes && config.remove_dups)) {
+        merge_remapped_duplicates(config, &tileset, &converted, &numBaseMatches, &numPaletteSwaps);
+    }
 
     if (!config.quiet) {
-        printf("tilemap: %d, tiles: %d\n", (int) tilemap.size(), (int) tiles.size());
+        size_t tilemapSize = 0;
+        for (const ConvertedImage &c : converted) {
+            tilemapSize += c.tilemap.size();
+        }
+        printf("tilemap: %d, tiles: %d\n", (int) tilemapSize, (int) tiles.size());
+        if (config.maxDiff > 0) {
+            printf("Merged %d near-duplicate tiles, total pixel error: %ld\n", tileset.numLossyMerges, tileset.totalPixelError);
+        }
+        if (tileset.numBaseTiles > 0) {
+            printf("Replaced %d tiles with base tiles\n", numBaseMatches);
+        }
+        if (config.palSwapDupes) {
+            printf("Removed %d tiles duplicated with a different palette\n", numPaletteSwaps);
+        }
     }
 
     if (config.output_tile_image_filename != nullptr) {
-        write_tiles_to_png_image(config.output_tile_image_filename, palettes, &tiles);
+        write_tiles_to_png_image(config, config.output_tile_image_filename, palettes, tiles);
     }
 
     if (config.tmx_filename != nullptr) {
-        write_tmx_file(config.tmx_filename, image, palettes, &tiles, &tilemap, config.tileSize);
+        // The TMX files share one tileset image, encoded once.
+        const char *tilesetStem = converted.size() == 1 ? converted[0].filename : "tileset";
+        std::string tilesetFilename = input_output_filename(config.tmx_filename, tilesetStem) + ".png";
+        write_tiles_to_png_image(config, tilesetFilename.c_str(), palettes, tiles);
+        for (const ConvertedImage &c : converted) {
+            std::string filename = input_output_filename(config.tmx_filename, c.filename);
+            write_tmx_file(config, filename.c_str(), tilesetFilename.c_str(), c.width, c.height, c.tilemap);
+        }
     }
 
     if (config.palette_filename != nullptr) {
@@ -1157,14 +2038,16 @@ int process_file(const Config &config) {
     }
 
     if (config.tilemap_filename != nullptr) {
-        write_tilemap_file(config, &tilemap, image->width / TILE_WIDTH);
+        for (const ConvertedImage &c : converted) {
+            std::string filename = input_output_filename(config.tilemap_filename, c.filename);
+            write_tilemap_file(config, filename.c_str(), c.tilemap, c.width / TILE_WIDTH);
+        }
     }
 
     if (config.tiles_filename != nullptr) {
-        write_tiles(config, config.tiles_filename, &tiles);
+        write_tiles(config, config.tiles_filename, tiles, tileset.numBaseTiles);
     }
 
-    delete image;
     return 0;
 }
 
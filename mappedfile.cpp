@@ -0,0 +1,136 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "mappedfile.h"
+#include "lodepng.h"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#define PNG2TILE_MMAP_WIN32 1
+#elif defined(__unix__) || defined(__APPLE__)
+#define PNG2TILE_MMAP_POSIX 1
+#endif
+
+#if defined(PNG2TILE_MMAP_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(PNG2TILE_MMAP_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : contents(nullptr), contentsSize(0), mapped(false) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+unsigned MappedFile::open(const char *filename) {
+    close();
+    if (map(filename)) {
+        return 0;
+    }
+
+    unsigned error = lodepng::load_file(buffer, filename);
+    if (error) {
+        return error;
+    }
+    contents = buffer.empty() ? nullptr : &buffer[0];
+    contentsSize = buffer.size();
+    return 0;
+}
+
+void MappedFile::close() {
+    if (mapped) {
+#if defined(PNG2TILE_MMAP_WIN32)
+        UnmapViewOfFile(contents);
+#elif defined(PNG2TILE_MMAP_POSIX)
+        munmap((void *) contents, contentsSize);
+#endif
+    }
+    std::vector<unsigned char>().swap(buffer);
+    contents = nullptr;
+    contentsSize = 0;
+    mapped = false;
+}
+
+// Maps the file, keeping only the view: the file and mapping handles can be
+// closed once it exists. Empty files cannot be mapped and are read instead.
+bool MappedFile::map(const char *filename) {
+#if defined(PNG2TILE_MMAP_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t) size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    contents = (const unsigned char *) view;
+    contentsSize = (std::size_t) size.QuadPart;
+    mapped = true;
+    return true;
+#elif defined(PNG2TILE_MMAP_POSIX)
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0 ||
+        (uint64_t) info.st_size > SIZE_MAX) {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, (std::size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    // The decoder reads the file once, front to back.
+    madvise(view, (std::size_t) info.st_size, MADV_SEQUENTIAL);
+    contents = (const unsigned char *) view;
+    contentsSize = (std::size_t) info.st_size;
+    mapped = true;
+    return true;
+#else
+    (void) filename;
+    return false;
+#endif
+}
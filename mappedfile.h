@@ -0,0 +1,60 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_MAPPEDFILE_H
+#define PNG2TILE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <vector>
+
+// A whole input file, read-only. The file is memory-mapped where the
+// platform supports it, so its bytes come straight from the page cache
+// without being copied; otherwise, or if mapping fails, it is read into a
+// buffer. The contents stay valid until the file is closed or destroyed.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Returns 0, or lodepng error 78 if the file cannot be read.
+    unsigned open(const char *filename);
+    void close();
+
+    // Null for an empty file.
+    const unsigned char *data() const { return contents; }
+    std::size_t size() const { return contentsSize; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    bool map(const char *filename);
+
+    const unsigned char *contents;
+    std::size_t contentsSize;
+    bool mapped;
+    // The fallback copy when the file is not mapped.
+    std::vector<unsigned char> buffer;
+};
+
+#endif //PNG2TILE_MAPPEDFILE_H
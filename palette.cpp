@@ -24,73 +24,943 @@ SOFTWARE.
 #include "palette.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
-std::set<int> setUnion(const std::set<int>& a, const std::set<int>& b) {
-    std::set<int> result = a;
-    result.insert(b.begin(), b.end());
-    return result;
+// Failed states remembered before the memo stops growing.
+#define MAX_FAILED_STATES (1 << 20)
+// Nodes expanded between checks of the clock.
+#define NODES_PER_TIME_CHECK 1024
+// Node budget of the first randomized restart; later restarts get more.
+#define FIRST_RESTART_NODES 1000
+// Local search moves allowed before falling back to an exact search.
+#define REPAIR_STEPS_PER_INPUT 200
+#define REPAIR_MIN_STEPS 20000
+// Chance of a random move, and how many steps a move stays tabu to undo.
+#define REPAIR_NOISE_PERCENT 10
+#define REPAIR_TABU_TENURE 10
+
+namespace {
+
+bool bucketLess(const ColorSet &a, const ColorSet &b) {
+    return std::lexicographical_compare(a.words, a.words + COLOR_SET_WORDS, b.words, b.words + COLOR_SET_WORDS);
 }
 
-bool backtrack(
-    const std::vector<std::set<int>>& inputs,
-    size_t index,
-    std::vector<std::set<int>>& buckets,
-    size_t maxSize)
-{
-    if (index == inputs.size()) return true;
-
-    const std::set<int>& current = inputs[index];
-
-    for (size_t i = 0; i < buckets.size(); ++i) {
-        // Optimisation: skip duplicate bucket states to avoid redundant branches.
-        // If this bucket has the same contents as a previous one, we already
-        // tried assigning to an identical bucket and it either worked or failed.
-        bool isDuplicate = false;
-        for (size_t j = 0; j < i; ++j) {
-            if (buckets[j] == buckets[i]) {
-                isDuplicate = true;
+bool sizeGreater(const ColorSet &a, const ColorSet &b) {
+    return a.size() > b.size();
+}
+
+// Shared by every strategy working on one problem: counts the nodes each
+// expands and tells it when to give up, because the time budget ran out or
+// another strategy has already won.
+class SearchControl {
+public:
+    SearchControl(long timeoutMs, bool deterministic)
+        : timeoutMs(timeoutMs), deterministic(deterministic), stopped(false), timedOut(false),
+          bestNodes(~0UL), start(std::chrono::steady_clock::now()) {}
+
+    // Called once per node with the caller's running count. Returns false
+    // when the caller should abandon its search.
+    bool step(unsigned long nodes) {
+        if (stopped.load(std::memory_order_relaxed)) return false;
+        // A deterministic race is won by the fewest nodes, so a strategy
+        // already past the best success cannot win any more.
+        if (deterministic && nodes > bestNodes.load(std::memory_order_relaxed)) return false;
+        if (timeoutMs > 0 && nodes % NODES_PER_TIME_CHECK == 0 && elapsedMs() >= timeoutMs) {
+            timedOut = true;
+            stopped = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Records a finished search, keeping its buckets if it is the new winner.
+    // Lower priority values win ties.
+    void finish(bool success, bool complete, unsigned long nodes, int priority, const char *name,
+                const std::vector<ColorSet> &buckets) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!success) {
+            // A complete search that fails proves there is no answer.
+            if (complete) {
+                infeasible = true;
+                stopped = true;
+            }
+            return;
+        }
+        if (winnerName == nullptr || nodes < winnerNodes || (nodes == winnerNodes && priority < winnerPriority)) {
+            winnerName = name;
+            winnerNodes = nodes;
+            winnerPriority = priority;
+            winner = buckets;
+            bestNodes = nodes;
+            if (!deterministic) {
+                stopped = true;
+            }
+        }
+    }
+
+    long elapsedMs() const {
+        return (long) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    long timeoutMs;
+    bool deterministic;
+    std::atomic<bool> stopped;
+    std::atomic<bool> timedOut;
+    std::atomic<unsigned long> bestNodes;
+    // Only read once every strategy has finished.
+    bool infeasible = false;
+    const char *winnerName = nullptr;
+    unsigned long winnerNodes = 0;
+    int winnerPriority = 0;
+    std::vector<ColorSet> winner;
+
+private:
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Base for the strategies: the problem, a node counter and a way to stop.
+class Strategy {
+public:
+    Strategy(const std::vector<ColorSet> &inputs, std::size_t numBuckets, std::size_t maxSize, SearchControl &control)
+        : inputs(inputs), numBuckets(numBuckets), maxSize(maxSize), control(control), nodes(0), aborted(false) {}
+    virtual ~Strategy() {}
+
+    virtual const char *name() const = 0;
+    // True if failing without being aborted proves there is no answer.
+    virtual bool complete() const = 0;
+    // Fills buckets and returns true on success.
+    virtual bool solve(std::vector<ColorSet> &buckets) = 0;
+
+    unsigned long nodeCount() const { return nodes; }
+    bool wasAborted() const { return aborted; }
+
+protected:
+    const std::vector<ColorSet> &inputs;
+    std::size_t numBuckets;
+    std::size_t maxSize;
+    SearchControl &control;
+    unsigned long nodes;
+    bool aborted;
+
+    bool step() {
+        if (aborted || !control.step(++nodes)) {
+            aborted = true;
+            return false;
+        }
+        return true;
+    }
+};
+
+// The original search: inputs largest first, each tried in every bucket in
+// order, skipping buckets identical to an earlier one.
+class SizeOrderedSearch : public Strategy {
+public:
+    using Strategy::Strategy;
+
+    const char *name() const override { return "size-ordered DFS"; }
+    bool complete() const override { return true; }
+
+    bool solve(std::vector<ColorSet> &buckets) override {
+        order = inputs;
+        std::stable_sort(order.begin(), order.end(), sizeGreater);
+        buckets.assign(numBuckets, ColorSet());
+        return backtrack(0, buckets);
+    }
+
+private:
+    std::vector<ColorSet> order;
+
+    bool backtrack(size_t index, std::vector<ColorSet> &buckets) {
+        if (index == order.size()) return true;
+        if (!step()) return false;
+
+        const ColorSet &current = order[index];
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            bool isDuplicate = false;
+            for (size_t j = 0; j < i; ++j) {
+                if (buckets[j] == buckets[i]) {
+                    isDuplicate = true;
+                    break;
+                }
+            }
+            if (isDuplicate) continue;
+
+            ColorSet merged = buckets[i] | current;
+            if (merged.size() <= maxSize) {
+                ColorSet saved = buckets[i];
+                buckets[i] = merged;
+                if (backtrack(index + 1, buckets))
+                    return true;
+                buckets[i] = saved;
+                if (aborted) return false;
+            }
+        }
+        return false;
+    }
+};
+
+// Depth-first branch and bound over bucket contents.
+//
+// An input that is already a subset of some bucket can be placed there for
+// free, so the remaining work depends only on the multiset of buckets. That
+// makes the multiset a complete key for memoising failed states. The key is
+// a pair of sums of per-bucket hashes, kept up to date as buckets change,
+// so it is order independent and costs nothing to build at each node.
+// Each node branches on the unplaced input that fits the fewest distinct
+// buckets, trying the buckets that grow least first, and is cut off when the
+// colours not yet in any bucket exceed the free space left. Inputs only
+// ever become placed deeper in the search, so each node scans just the
+// inputs its parent left unplaced.
+class ConstrainedSearch : public Strategy {
+public:
+    using Strategy::Strategy;
+
+    const char *name() const override { return "most-constrained search"; }
+    bool complete() const override { return true; }
+
+    bool solve(std::vector<ColorSet> &buckets) override {
+        // Duplicates and inputs inside another input are placed along with
+        // the larger input, so only the maximal inputs are searched.
+        std::vector<ColorSet> sorted = inputs;
+        std::sort(sorted.begin(), sorted.end(), bucketLess);
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        std::vector<std::vector<ColorSet>> bySize(maxSize + 1);
+        for (const ColorSet &input : sorted) {
+            bySize[input.size()].push_back(input);
+        }
+        maximal.clear();
+        maximalSizes.clear();
+        for (std::size_t size = maxSize; size > 0; size--) {
+            // Only a strictly larger input can contain a distinct one.
+            std::size_t numLarger = maximal.size();
+            for (const ColorSet &input : bySize[size]) {
+                bool inside = false;
+                for (std::size_t j = 0; j < numLarger; j++) {
+                    if (input.isSubsetOf(maximal[j])) {
+                        inside = true;
+                        break;
+                    }
+                }
+                if (!inside) {
+                    maximal.push_back(input);
+                    maximalSizes.push_back(size);
+                }
+            }
+        }
+
+        numWords = 1;
+        for (const ColorSet &input : maximal) {
+            for (int w = numWords; w < COLOR_SET_WORDS; w++) {
+                if (input.words[w] != 0) numWords = w + 1;
+            }
+        }
+
+        buckets.assign(numBuckets, ColorSet());
+        key = StateKey();
+        for (const ColorSet &bucket : buckets) {
+            addToKey(bucket, 1);
+        }
+        pending.assign(1, std::vector<uint32_t>());
+        for (uint32_t i = 0; i < maximal.size(); i++) {
+            pending[0].push_back(i);
+        }
+        return search(buckets, 0);
+    }
+
+private:
+    struct StateKey {
+        uint64_t a;
+        uint64_t b;
+
+        StateKey() : a(0), b(0) {}
+
+        bool operator==(const StateKey &other) const { return a == other.a && b == other.b; }
+    };
+
+    struct StateKeyHash {
+        std::size_t operator()(const StateKey &key) const { return (std::size_t) key.a; }
+    };
+
+    std::vector<ColorSet> maximal;
+    std::vector<std::size_t> maximalSizes;
+    std::unordered_set<StateKey, StateKeyHash> failed;
+    StateKey key;
+    // The unplaced inputs at each depth, reused from node to node.
+    std::vector<std::vector<uint32_t>> pending;
+
+    // Colour sets here only ever hold colours from the inputs, so the inner
+    // loop skips the words above the highest colour any input uses.
+    int numWords;
+
+    bool isSubset(const ColorSet &a, const ColorSet &b) const {
+        uint64_t outside = 0;
+        for (int w = 0; w < numWords; w++) {
+            outside |= a.words[w] & ~b.words[w];
+        }
+        return outside == 0;
+    }
+
+    // The number of colours in a that b lacks.
+    std::size_t newColours(const ColorSet &a, const ColorSet &b) const {
+        std::size_t count = 0;
+        for (int w = 0; w < numWords; w++) {
+            count += ColorSet::popcount(a.words[w] & ~b.words[w]);
+        }
+        return count;
+    }
+
+    // Adds (sign 1) or removes (sign -1) a bucket from the key.
+    void addToKey(const ColorSet &bucket, int sign) {
+        uint64_t h = bucket.hash();
+        uint64_t a = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ULL;
+        uint64_t b = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        key.a += sign > 0 ? a ^ (a >> 29) : 0 - (a ^ (a >> 29));
+        key.b += sign > 0 ? b ^ (b >> 32) : 0 - (b ^ (b >> 32));
+    }
+
+    void setBucket(std::vector<ColorSet> &buckets, std::size_t b, const ColorSet &value) {
+        addToKey(buckets[b], -1);
+        buckets[b] = value;
+        addToKey(value, 1);
+    }
+
+    bool search(std::vector<ColorSet> &buckets, std::size_t depth) {
+        if (!step()) return false;
+
+        if (failed.count(key) != 0) {
+            return false;
+        }
+
+        StateKey state = key;
+        if (!expand(buckets, depth)) {
+            if (!aborted && failed.size() < MAX_FAILED_STATES) {
+                failed.insert(state);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    bool expand(std::vector<ColorSet> &buckets, std::size_t depth) {
+        ColorSet used;
+        std::size_t freeSpace = 0;
+        for (const ColorSet &bucket : buckets) {
+            used |= bucket;
+            freeSpace += maxSize - bucket.size();
+        }
+
+        // Buckets with the same contents are interchangeable; only the first
+        // of each is branched on.
+        std::vector<std::size_t> distinct;
+        std::vector<std::size_t> room;
+        for (std::size_t i = 0; i < buckets.size(); i++) {
+            bool seen = false;
+            for (std::size_t j : distinct) {
+                if (buckets[j] == buckets[i]) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen) {
+                distinct.push_back(i);
+                room.push_back(maxSize - buckets[i].size());
+            }
+        }
+
+        if (pending.size() <= depth + 1) {
+            pending.resize(depth + 2);
+        }
+        const std::vector<uint32_t> &unplaced = pending[depth];
+        std::vector<uint32_t> &remaining = pending[depth + 1];
+        remaining.clear();
+        ColorSet needed;
+        std::size_t best = maximal.size();
+        std::size_t bestFits = distinct.size() + 1;
+        bool forced = false;
+        for (std::size_t n = 0; n < unplaced.size(); n++) {
+            uint32_t i = unplaced[n];
+            const ColorSet &input = maximal[i];
+            std::size_t fits = 0;
+            bool placed = false;
+            for (std::size_t d = 0; d < distinct.size(); d++) {
+                const ColorSet &bucket = buckets[distinct[d]];
+                if (isSubset(input, bucket)) {
+                    placed = true;
+                    break;
+                }
+                // Most inputs are smaller than the room left, which settles
+                // it without counting the union.
+                if (maximalSizes[i] <= room[d] || newColours(input, bucket) <= room[d]) {
+                    fits++;
+                }
+            }
+            if (placed) continue;
+
+            if (fits == 0) return false;
+            remaining.push_back(i);
+            needed |= input;
+            if (fits < bestFits || (fits == bestFits && maximalSizes[i] > maximalSizes[best])) {
+                best = i;
+                bestFits = fits;
+            }
+            // An input with one choice left is branched on at once: the
+            // branch cannot be avoided, so the rest of the scan only
+            // matters to the child, which rescans the inputs it is handed.
+            if (fits == 1 && distinct.size() > 1) {
+                remaining.insert(remaining.end(), unplaced.begin() + n + 1, unplaced.end());
+                forced = true;
                 break;
             }
         }
-        if (isDuplicate) continue;
 
-        std::set<int> merged = setUnion(buckets[i], current);
-        if (merged.size() <= maxSize) {
-            std::set<int> saved = buckets[i];
-            buckets[i] = merged;
-            if (backtrack(inputs, index + 1, buckets, maxSize))
+        if (best == maximal.size()) return true;
+
+        // Lower bound: every colour not yet in a bucket needs a free slot.
+        ColorSet newColours;
+        for (int w = 0; w < COLOR_SET_WORDS; w++) {
+            newColours.words[w] = needed.words[w] & ~used.words[w];
+        }
+        if (!forced && newColours.size() > freeSpace) return false;
+
+        const ColorSet &current = maximal[best];
+        std::vector<std::pair<std::size_t, std::size_t>> choices;
+        for (std::size_t b : distinct) {
+            std::size_t merged = (buckets[b] | current).size();
+            if (merged <= maxSize) {
+                choices.push_back(std::make_pair(merged - buckets[b].size(), b));
+            }
+        }
+        std::sort(choices.begin(), choices.end());
+
+        for (const auto &choice : choices) {
+            std::size_t b = choice.second;
+            ColorSet saved = buckets[b];
+            setBucket(buckets, b, saved | current);
+            if (search(buckets, depth + 1))
+                return true;
+            setBucket(buckets, b, saved);
+            if (aborted) return false;
+        }
+        return false;
+    }
+};
+
+// Repeated short DFS runs, each with its own random input and bucket order
+// and a node budget that grows by half each time, so that a run stuck in a
+// bad early choice is abandoned quickly.
+class RandomRestartSearch : public Strategy {
+public:
+    RandomRestartSearch(const std::vector<ColorSet> &inputs, std::size_t numBuckets, std::size_t maxSize,
+                        SearchControl &control, uint32_t seed)
+        : Strategy(inputs, numBuckets, maxSize, control), random(seed), budget(0) {}
+
+    const char *name() const override { return "randomized restarts"; }
+    bool complete() const override { return false; }
+
+    bool solve(std::vector<ColorSet> &buckets) override {
+        for (unsigned long limit = FIRST_RESTART_NODES; !aborted; limit += limit / 2) {
+            // Keep the large inputs roughly first but shuffle within that.
+            order = inputs;
+            std::shuffle(order.begin(), order.end(), random);
+            std::stable_sort(order.begin(), order.end(), [this](const ColorSet &a, const ColorSet &b) {
+                return a.size() / 2 > b.size() / 2;
+            });
+            budget = limit;
+            buckets.assign(numBuckets, ColorSet());
+            if (backtrack(0, buckets)) return true;
+        }
+        return false;
+    }
+
+private:
+    std::mt19937 random;
+    std::vector<ColorSet> order;
+    unsigned long budget;
+
+    bool backtrack(size_t index, std::vector<ColorSet> &buckets) {
+        if (index == order.size()) return true;
+        if (budget == 0 || !step()) return false;
+        budget--;
+
+        const ColorSet &current = order[index];
+        for (const ColorSet &bucket : buckets) {
+            if (current.isSubsetOf(bucket)) {
+                return backtrack(index + 1, buckets);
+            }
+        }
+
+        std::vector<size_t> choices;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            bool isDuplicate = false;
+            for (size_t j : choices) {
+                if (buckets[j] == buckets[i]) {
+                    isDuplicate = true;
+                    break;
+                }
+            }
+            if (!isDuplicate && (buckets[i] | current).size() <= maxSize) {
+                choices.push_back(i);
+            }
+        }
+        std::shuffle(choices.begin(), choices.end(), random);
+
+        for (size_t i : choices) {
+            ColorSet saved = buckets[i];
+            buckets[i] |= current;
+            if (backtrack(index + 1, buckets))
                 return true;
             buckets[i] = saved;
+            if (aborted || budget == 0) return false;
         }
+        return false;
     }
+};
+
+// Greedy warm start followed by min-conflicts local search, the scheme
+// WalkSAT uses for SAT. Every input always sits in some bucket and buckets
+// may hold too many colours. The warm start packs groups of inputs that
+// share colours (see warmStart), then inputs largest first where they add
+// the fewest colours. Each later step moves one input out of an overfull
+// bucket to the bucket where the total excess drops most, with occasional
+// random moves and a short tabu on undoing a move. Per-bucket colour counts
+// make a move cost O(colours in the input), so this scales to many buckets
+// and inputs where the tree searches cannot.
+class RepairSearch : public Strategy {
+public:
+    RepairSearch(const std::vector<ColorSet> &inputs, std::size_t numBuckets, std::size_t maxSize,
+                 SearchControl &control, uint32_t seed)
+        : Strategy(inputs, numBuckets, maxSize, control), random(seed) {}
+
+    const char *name() const override { return "greedy + local search"; }
+    bool complete() const override { return false; }
+
+    bool solve(std::vector<ColorSet> &buckets) override {
+        std::size_t numInputs = inputs.size();
+        colors.resize(numInputs);
+        for (std::size_t i = 0; i < numInputs; i++) {
+            colors[i] = inputs[i].colors();
+        }
+        // Colours used by the most inputs are the likeliest to be shared by
+        // several palettes; try treating the first few as shared.
+        std::vector<std::size_t> uses(COLOR_SET_BITS, 0);
+        for (std::size_t i = 0; i < numInputs; i++) {
+            for (int c : colors[i]) {
+                uses[c]++;
+            }
+        }
+        std::vector<int> byUse;
+        for (int c = 0; c < COLOR_SET_BITS; c++) {
+            if (uses[c] > 0) byUse.push_back(c);
+        }
+        std::stable_sort(byUse.begin(), byUse.end(), [&uses](int a, int b) {
+            return uses[a] > uses[b];
+        });
+
+        std::size_t bestShared = 0;
+        long bestStartExcess = -1;
+        for (std::size_t shared = 0; shared < maxSize && shared < byUse.size(); shared++) {
+            if (!warmStart(byUse, shared)) return false;
+            if (bestStartExcess < 0 || excess < bestStartExcess) {
+                bestShared = shared;
+                bestStartExcess = excess;
+            }
+            if (excess == 0) break;
+        }
+        if (excess != bestStartExcess && !warmStart(byUse, bestShared)) return false;
+
+        std::size_t maxSteps = REPAIR_STEPS_PER_INPUT * numInputs + REPAIR_MIN_STEPS;
+        std::vector<std::size_t> tabuUntil(numInputs * numBuckets, 0);
+        std::vector<std::size_t> overfull;
+        std::vector<std::size_t> ties;
+        long bestExcess = excess;
+        // With a single bucket there is nowhere to move to.
+        if (numBuckets < 2) maxSteps = 0;
+        for (std::size_t iteration = 1; excess > 0 && iteration <= maxSteps; iteration++) {
+            if (!step()) return false;
+
+            overfull.clear();
+            for (std::size_t b = 0; b < numBuckets; b++) {
+                if (sizes[b] > maxSize) overfull.push_back(b);
+            }
+            std::size_t from = overfull[random() % overfull.size()];
+            std::size_t input = members[from][random() % members[from].size()];
+            long removeDelta = overflow(sizes[from] - removed(input, from)) - overflow(sizes[from]);
+
+            std::size_t to = from;
+            if (random() % 100 < REPAIR_NOISE_PERCENT) {
+                to = (from + 1 + random() % (numBuckets - 1)) % numBuckets;
+            } else {
+                long bestDelta = 0;
+                ties.clear();
+                for (std::size_t b = 0; b < numBuckets; b++) {
+                    if (b == from) continue;
+                    long delta = removeDelta + overflow(sizes[b] + added(input, b)) - overflow(sizes[b]);
+                    // Tabu moves are allowed only if they beat the best excess so far.
+                    if (tabuUntil[input * numBuckets + b] > iteration && excess + delta >= bestExcess) continue;
+                    if (ties.empty() || delta < bestDelta) {
+                        ties.clear();
+                        bestDelta = delta;
+                    }
+                    if (delta == bestDelta) ties.push_back(b);
+                }
+                if (ties.empty()) continue;
+                to = ties[random() % ties.size()];
+            }
+
+            unplace(input);
+            place(input, to);
+            tabuUntil[input * numBuckets + from] = iteration + REPAIR_TABU_TENURE;
+            bestExcess = std::min(bestExcess, excess);
+        }
+
+        if (excess > 0) return false;
+
+        buckets.assign(numBuckets, ColorSet());
+        for (std::size_t b = 0; b < numBuckets; b++) {
+            for (int c = 0; c < COLOR_SET_BITS; c++) {
+                if (counts[b * COLOR_SET_BITS + c] > 0) buckets[b].insert(c);
+            }
+        }
+        return true;
+    }
+
+private:
+    std::mt19937 random;
+    std::vector<std::vector<int>> colors;
+    // counts[b * COLOR_SET_BITS + c] is the number of inputs in bucket b using colour c.
+    std::vector<uint32_t> counts;
+    std::vector<std::size_t> sizes;
+    std::vector<std::vector<std::size_t>> members;
+    std::vector<std::size_t> assignment;
+    std::vector<std::size_t> position;
+    // Colours over maxSize, summed over all buckets.
+    long excess;
 
-    return false;
+    // Places every input, resetting any earlier placement. Inputs linked by
+    // colours other than the first numShared of sharedOrder form components.
+    // A component that fits in one bucket alongside the shared colours is
+    // placed whole, so separate groups of tiles (different areas of a
+    // picture) are packed like items in bin packing. Inputs of larger
+    // components are placed one by one. Returns false if stopped.
+    bool warmStart(const std::vector<int> &sharedOrder, std::size_t numShared) {
+        std::size_t numInputs = inputs.size();
+        counts.assign(numBuckets * COLOR_SET_BITS, 0);
+        sizes.assign(numBuckets, 0);
+        members.assign(numBuckets, std::vector<std::size_t>());
+        assignment.assign(numInputs, 0);
+        position.assign(numInputs, 0);
+        excess = 0;
+
+        ColorSet shared;
+        for (std::size_t i = 0; i < numShared; i++) {
+            shared.insert(sharedOrder[i]);
+        }
+        std::vector<int> parent(COLOR_SET_BITS);
+        for (int c = 0; c < COLOR_SET_BITS; c++) {
+            parent[c] = c;
+        }
+        // Inputs made only of shared colours are keyed by their first colour.
+        std::vector<int> key(numInputs, -1);
+        for (std::size_t i = 0; i < numInputs; i++) {
+            for (int c : colors[i]) {
+                if (shared.contains(c)) continue;
+                if (key[i] < 0) {
+                    key[i] = c;
+                } else {
+                    parent[findRoot(parent, c)] = findRoot(parent, key[i]);
+                }
+            }
+            if (key[i] < 0 && !colors[i].empty()) key[i] = colors[i][0];
+        }
+        std::vector<ColorSet> componentColors(COLOR_SET_BITS);
+        std::vector<std::vector<std::size_t>> componentInputs(COLOR_SET_BITS);
+        for (std::size_t i = 0; i < numInputs; i++) {
+            if (key[i] < 0) continue;
+            int root = findRoot(parent, key[i]);
+            componentColors[root] |= inputs[i];
+            componentInputs[root].push_back(i);
+        }
+        std::vector<int> components;
+        for (int c = 0; c < COLOR_SET_BITS; c++) {
+            if (!componentInputs[c].empty()) components.push_back(c);
+        }
+        std::stable_sort(components.begin(), components.end(), [&componentColors](int a, int b) {
+            return componentColors[a].size() > componentColors[b].size();
+        });
+
+        for (int component : components) {
+            std::vector<std::size_t> &order = componentInputs[component];
+            if ((componentColors[component] | shared).size() <= maxSize) {
+                std::size_t best = bestBucket(componentColors[component].colors());
+                for (std::size_t i : order) {
+                    if (!step()) return false;
+                    place(i, best);
+                }
+                continue;
+            }
+            std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+                return colors[a].size() > colors[b].size();
+            });
+            for (std::size_t i : order) {
+                if (!step()) return false;
+                place(i, bestBucket(colors[i]));
+            }
+        }
+        // Inputs without colours go anywhere.
+        for (std::size_t i = 0; i < numInputs; i++) {
+            if (colors[i].empty()) place(i, 0);
+        }
+        return true;
+    }
+
+    static int findRoot(std::vector<int> &parent, int c) {
+        while (parent[c] != c) {
+            parent[c] = parent[parent[c]];
+            c = parent[c];
+        }
+        return c;
+    }
+
+    // The bucket where the given colours add the least excess, then the
+    // fewest new colours.
+    std::size_t bestBucket(const std::vector<int> &newColors) const {
+        std::size_t best = 0;
+        long bestCost = 0;
+        std::size_t bestGrowth = 0;
+        for (std::size_t b = 0; b < numBuckets; b++) {
+            std::size_t growth = 0;
+            for (int c : newColors) {
+                if (counts[b * COLOR_SET_BITS + c] == 0) growth++;
+            }
+            long cost = overflow(sizes[b] + growth) - overflow(sizes[b]);
+            if (b == 0 || cost < bestCost || (cost == bestCost && growth < bestGrowth)) {
+                best = b;
+                bestCost = cost;
+                bestGrowth = growth;
+            }
+        }
+        return best;
+    }
+
+    long overflow(std::size_t size) const {
+        return size > maxSize ? (long) (size - maxSize) : 0;
+    }
+
+    // Colours input i would add to bucket b.
+    std::size_t added(std::size_t i, std::size_t b) const {
+        std::size_t n = 0;
+        for (int c : colors[i]) {
+            if (counts[b * COLOR_SET_BITS + c] == 0) n++;
+        }
+        return n;
+    }
+
+    // Colours bucket b would lose without input i, which is in it.
+    std::size_t removed(std::size_t i, std::size_t b) const {
+        std::size_t n = 0;
+        for (int c : colors[i]) {
+            if (counts[b * COLOR_SET_BITS + c] == 1) n++;
+        }
+        return n;
+    }
+
+    void place(std::size_t i, std::size_t b) {
+        excess -= overflow(sizes[b]);
+        for (int c : colors[i]) {
+            if (counts[b * COLOR_SET_BITS + c]++ == 0) sizes[b]++;
+        }
+        excess += overflow(sizes[b]);
+        assignment[i] = b;
+        position[i] = members[b].size();
+        members[b].push_back(i);
+    }
+
+    void unplace(std::size_t i) {
+        std::size_t b = assignment[i];
+        excess -= overflow(sizes[b]);
+        for (int c : colors[i]) {
+            if (--counts[b * COLOR_SET_BITS + c] == 0) sizes[b]--;
+        }
+        excess += overflow(sizes[b]);
+        std::size_t last = members[b].back();
+        members[b][position[i]] = last;
+        position[last] = position[i];
+        members[b].pop_back();
+    }
+};
+
+// One pass, no backtracking: inputs largest first, each into the first
+// bucket that already contains it or can take its colours.
+class GreedyFirstFit : public Strategy {
+public:
+    using Strategy::Strategy;
+
+    const char *name() const override { return "greedy first-fit"; }
+    bool complete() const override { return false; }
+
+    bool solve(std::vector<ColorSet> &buckets) override {
+        std::vector<ColorSet> order = inputs;
+        std::stable_sort(order.begin(), order.end(), sizeGreater);
+        buckets.assign(numBuckets, ColorSet());
+
+        for (const ColorSet &input : order) {
+            if (!step()) return false;
+            bool placed = false;
+            for (const ColorSet &bucket : buckets) {
+                if (input.isSubsetOf(bucket)) {
+                    placed = true;
+                    break;
+                }
+            }
+            for (size_t i = 0; !placed && i < buckets.size(); i++) {
+                if ((buckets[i] | input).size() <= maxSize) {
+                    buckets[i] |= input;
+                    placed = true;
+                }
+            }
+            if (!placed) return false;
+        }
+        return true;
+    }
+};
+
+void checkInputs(const std::vector<ColorSet> &inputs, std::size_t numBuckets, std::size_t maxSize) {
+    if (numBuckets < 1)
+        throw std::invalid_argument("numBuckets must be at least 1");
+
+    for (const ColorSet& input : inputs) {
+        if (input.size() > maxSize)
+            throw std::runtime_error(
+                "A tile uses " + std::to_string(input.size()) +
+                " colours, more than the " + std::to_string(maxSize) + " a palette can hold");
+    }
 }
 
-std::vector<std::set<int>> reduceToNBuckets(
-    std::vector<std::set<int>> inputs,
+std::runtime_error partitionError(std::size_t numBuckets, std::size_t maxSize) {
+    return std::runtime_error(
+        "Cannot partition input sets into " + std::to_string(numBuckets) +
+        " buckets of size <= " + std::to_string(maxSize));
+}
+
+PaletteTimeoutError timeoutError(const SearchControl &control, unsigned long nodes) {
+    return PaletteTimeoutError(
+        "Palette search timed out after " + std::to_string(control.elapsedMs()) + " ms (" +
+        std::to_string(nodes) + " states explored)");
+}
+
+}
+
+std::vector<ColorSet> reduceToNBuckets(
+    std::vector<ColorSet> inputs,
     std::size_t numBuckets,
-    std::size_t maxSize)
+    std::size_t maxSize,
+    const PaletteSearchOptions &options,
+    PaletteSearchResult *result)
 {
-    if (numBuckets < 2 || numBuckets > 4)
-        throw std::invalid_argument("numBuckets must be between 2 and 4 inclusive");
+    checkInputs(inputs, numBuckets, maxSize);
 
-    // Sort largest sets first to fail fast on infeasible cases
-    std::sort(inputs.begin(), inputs.end(),
-        [](const std::set<int>& a, const std::set<int>& b) {
-            return a.size() > b.size();
-        });
+    // Strategies in order of priority for ties.
+    SearchControl control(options.timeoutMs, options.mode != PALETTE_SEARCH_PORTFOLIO || options.deterministic);
+    std::vector<std::unique_ptr<Strategy>> strategies;
+    switch (options.mode) {
+        case PALETTE_SEARCH_EXACT:
+            strategies.emplace_back(new ConstrainedSearch(inputs, numBuckets, maxSize, control));
+            break;
+        case PALETTE_SEARCH_SIZE_ORDERED:
+            strategies.emplace_back(new SizeOrderedSearch(inputs, numBuckets, maxSize, control));
+            break;
+        case PALETTE_SEARCH_PORTFOLIO:
+            strategies.emplace_back(new ConstrainedSearch(inputs, numBuckets, maxSize, control));
+            strategies.emplace_back(new SizeOrderedSearch(inputs, numBuckets, maxSize, control));
+            strategies.emplace_back(new GreedyFirstFit(inputs, numBuckets, maxSize, control));
+            strategies.emplace_back(new RepairSearch(inputs, numBuckets, maxSize, control, options.seed));
+            strategies.emplace_back(new RandomRestartSearch(inputs, numBuckets, maxSize, control, options.seed));
+            break;
+        default:
+            // Local search first; the exact search settles what it cannot.
+            strategies.emplace_back(new RepairSearch(inputs, numBuckets, maxSize, control, options.seed));
+            strategies.emplace_back(new ConstrainedSearch(inputs, numBuckets, maxSize, control));
+            break;
+    }
+
+    if (options.mode == PALETTE_SEARCH_PORTFOLIO) {
+        // Every strategy gets its own thread.
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < strategies.size(); i++) {
+            threads.emplace_back([&, i]() {
+                Strategy &strategy = *strategies[i];
+                std::vector<ColorSet> buckets;
+                bool success = strategy.solve(buckets);
+                bool complete = strategy.complete() && !strategy.wasAborted();
+                control.finish(success, complete, strategy.nodeCount(), (int) i, strategy.name(), buckets);
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    } else {
+        for (size_t i = 0; i < strategies.size() && control.winnerName == nullptr && !control.stopped; i++) {
+            Strategy &strategy = *strategies[i];
+            std::vector<ColorSet> buckets;
+            bool success = strategy.solve(buckets);
+            bool complete = strategy.complete() && !strategy.wasAborted();
+            control.finish(success, complete, strategy.nodeCount(), (int) i, strategy.name(), buckets);
+        }
+    }
+
+    if (control.winnerName != nullptr) {
+        if (result != nullptr) {
+            result->strategy = control.winnerName;
+            result->nodes = control.winnerNodes;
+        }
+        return control.winner;
+    }
 
-    std::vector<std::set<int>> buckets(numBuckets);
+    unsigned long nodes = 0;
+    for (const auto &strategy : strategies) {
+        nodes += strategy->nodeCount();
+    }
+    if (control.timedOut && !control.infeasible) throw timeoutError(control, nodes);
+    throw partitionError(numBuckets, maxSize);
+}
 
-    if (!backtrack(inputs, 0, buckets, maxSize))
-        throw std::runtime_error(
-            "Cannot partition input sets into " + std::to_string(numBuckets) +
-            " buckets of size <= " + std::to_string(maxSize));
+std::vector<ColorSet> reduceToNBuckets(
+    std::vector<ColorSet> inputs,
+    std::size_t numBuckets,
+    std::size_t maxSize,
+    long timeoutMs)
+{
+    PaletteSearchOptions options = {timeoutMs, PALETTE_SEARCH_DEFAULT, true, 0};
+    return reduceToNBuckets(inputs, numBuckets, maxSize, options);
+}
 
+std::vector<std::set<int>> reduceToNBuckets(
+    std::vector<std::set<int>> inputs,
+    std::size_t numBuckets,
+    std::size_t maxSize,
+    long timeoutMs)
+{
+    std::vector<ColorSet> masks;
+    masks.reserve(inputs.size());
+    for (const std::set<int>& input : inputs) {
+        masks.push_back(ColorSet::fromSet(input));
+    }
+
+    std::vector<std::set<int>> buckets;
+    for (const ColorSet& bucket : reduceToNBuckets(masks, numBuckets, maxSize, timeoutMs)) {
+        buckets.push_back(bucket.toSet());
+    }
     return buckets;
-}
\ No newline at end of file
+}
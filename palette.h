@@ -23,12 +23,72 @@ SOFTWARE.
 */
 #ifndef PNG2TILE_PALETTE_H
 #define PNG2TILE_PALETTE_H
+#include <cstdint>
 #include <set>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "colorset.h"
+
+// Thrown by reduceToNBuckets when the search runs out of time.
+class PaletteTimeoutError : public std::runtime_error {
+public:
+    explicit PaletteTimeoutError(const std::string &message) : std::runtime_error(message) {}
+};
+
+typedef enum {
+    // Greedy warm start and local search, then exact search if they fail.
+    PALETTE_SEARCH_DEFAULT,
+    // Branch and bound only.
+    PALETTE_SEARCH_EXACT,
+    // The original DFS, largest colour sets first.
+    PALETTE_SEARCH_SIZE_ORDERED,
+    // Every strategy raced on its own thread; the first answer wins.
+    PALETTE_SEARCH_PORTFOLIO
+} PaletteSearchMode;
+
+typedef struct {
+    // Give up after this many milliseconds; 0 means no limit.
+    long timeoutMs;
+    PaletteSearchMode mode;
+    // Make the portfolio's answer independent of thread timing: the winner
+    // is the strategy that needs the fewest search steps. An answer cut short
+    // by timeoutMs can still vary.
+    bool deterministic;
+    // Seed for the randomized strategies.
+    uint32_t seed;
+} PaletteSearchOptions;
+
+typedef struct {
+    const char *strategy;
+    unsigned long nodes;
+} PaletteSearchResult;
+
+// Packs the input colour sets into numBuckets palettes of at most maxSize
+// colours, so that every input fits in one bucket. Throws std::runtime_error
+// if that is impossible, or PaletteTimeoutError if no answer is found within
+// timeoutMs milliseconds (0 means no limit).
+std::vector<ColorSet> reduceToNBuckets(
+    std::vector<ColorSet> inputs,
+    std::size_t numBuckets,
+    std::size_t maxSize = 16,
+    long timeoutMs = 0);
+
+// As above, with a choice of search. If result is given it is set to the
+// strategy that found the answer.
+std::vector<ColorSet> reduceToNBuckets(
+    std::vector<ColorSet> inputs,
+    std::size_t numBuckets,
+    std::size_t maxSize,
+    const PaletteSearchOptions &options,
+    PaletteSearchResult *result = nullptr);
+
+// std::set interface to the above.
 std::vector<std::set<int>> reduceToNBuckets(
     std::vector<std::set<int>> inputs,
     std::size_t numBuckets,
-    std::size_t maxSize = 16);
+    std::size_t maxSize = 16,
+    long timeoutMs = 0);
 
 #endif //PNG2TILE_PALETTE_H
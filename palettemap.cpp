@@ -0,0 +1,55 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "palettemap.h"
+
+PaletteMap::PaletteMap(const std::vector<ColorSet> &palettes)
+    : masks(palettes), tables(palettes.size() * COLOR_SET_BITS, 0), cache() {
+    for (std::size_t i = 0; i < palettes.size(); i++) {
+        unsigned char *table = &tables[i * COLOR_SET_BITS];
+        int entry = 0;
+        for (int color : palettes[i].colors()) {
+            table[color] = (unsigned char) entry++;
+        }
+    }
+}
+
+int PaletteMap::find(const ColorSet &colors) {
+    CacheEntry &cached = cache[colors.hash() & (PALETTE_MAP_CACHE_SIZE - 1)];
+    if (cached.used && cached.colors == colors) {
+        return cached.palette;
+    }
+
+    int palette = -1;
+    for (std::size_t i = 0; i < masks.size(); i++) {
+        if (colors.isSubsetOf(masks[i])) {
+            palette = (int) i;
+            break;
+        }
+    }
+    cached.colors = colors;
+    cached.palette = palette;
+    cached.used = true;
+    return palette;
+}
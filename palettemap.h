@@ -0,0 +1,62 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_PALETTEMAP_H
+#define PNG2TILE_PALETTEMAP_H
+
+#include <cstddef>
+#include <vector>
+
+#include "colorset.h"
+
+// Direct-mapped cache of recent colour-set lookups; must be a power of two.
+#define PALETTE_MAP_CACHE_SIZE 64
+
+// The final palettes, prepared once so that Tile::setPalette needs no
+// allocation: a colour mask per palette for the subset test and a table
+// mapping every image colour index to its entry in that palette.
+class PaletteMap {
+public:
+    explicit PaletteMap(const std::vector<ColorSet> &palettes);
+
+    // Index of the first palette holding every colour in colors, or -1.
+    int find(const ColorSet &colors);
+    // COLOR_SET_BITS entries; colours outside the palette map to 0.
+    const unsigned char *remapTable(int palette) const {
+        return &tables[(std::size_t) palette * COLOR_SET_BITS];
+    }
+    std::size_t size() const { return masks.size(); }
+
+private:
+    struct CacheEntry {
+        ColorSet colors;
+        int palette;
+        bool used;
+    };
+
+    std::vector<ColorSet> masks;
+    std::vector<unsigned char> tables;
+    CacheEntry cache[PALETTE_MAP_CACHE_SIZE];
+};
+
+#endif //PNG2TILE_PALETTEMAP_H
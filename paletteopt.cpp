@@ -0,0 +1,454 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "paletteopt.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "tile.h"
+
+// Moves evaluated, and tiles rehashed over all moves, before giving up on
+// finding a better one. Bounds the time spent on large images.
+#define PALETTE_OPTIMIZE_MAX_MOVES 2000
+#define PALETTE_OPTIMIZE_MAX_REHASHES 1000000
+// Moves in a row that may leave the score unchanged, and how many moves
+// after a move its inputs may not go back.
+#define PALETTE_OPTIMIZE_MAX_SIDEWAYS 50
+#define PALETTE_OPTIMIZE_TABU_TENURE 10
+
+namespace {
+
+class PaletteOptimizer {
+public:
+    PaletteOptimizer(const std::vector<ColorSet> &inputs, const TileStore &tiles, uint32_t firstTile,
+                     std::size_t numPalettes, std::size_t maxSize, bool mirrored, bool mergeSwaps)
+        : inputs(inputs), numPalettes(numPalettes), maxSize(maxSize), mirrored(mirrored), mergeSwaps(mergeSwaps),
+          counts(numPalettes * COLOR_SET_BITS, 0), palettes(numPalettes), tables(numPalettes * COLOR_SET_BITS, 0),
+          assignment(inputs.size(), 0), totalColors(0), numUnique(0), numRehashes(0) {
+        for (uint32_t t = firstTile; t < tiles.size(); t++) {
+            TileState tile;
+            tile.colors = tiles.colors(t);
+            tile_unpack_planes(tiles.planes(t), tile.pixels);
+            tile.palette = -1;
+            tile.hash = 0;
+            tileStates.push_back(tile);
+        }
+    }
+
+    // Sets the palettes, putting every input in the first palette that holds
+    // it. Returns false if some input or tile fits in none.
+    bool reset(const std::vector<ColorSet> &start) {
+        std::fill(counts.begin(), counts.end(), 0);
+        palettes.assign(numPalettes, ColorSet());
+        totalColors = 0;
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            int p = firstPalette(start, inputs[i]);
+            if (p < 0) return false;
+            assignment[i] = (std::size_t) p;
+            addInput(i, (std::size_t) p);
+        }
+        for (std::size_t p = 0; p < numPalettes; p++) {
+            buildTable(p);
+        }
+
+        hashCounts.clear();
+        numUnique = 0;
+        for (TileState &tile : tileStates) {
+            tile.palette = firstPalette(palettes, tile.colors);
+            if (tile.palette < 0) return false;
+            tile.hash = mergeSwaps ? localHash(tile) : 0;
+            countTile(tile.hash, 1);
+        }
+        return true;
+    }
+
+    // Sets the palettes exactly as given, without trimming them to the
+    // inputs, and reports the unique tiles and free entries they give.
+    // reset() must be called before optimizing.
+    void score(const std::vector<ColorSet> &start, std::size_t *numTiles, std::size_t *numFree) {
+        palettes = start;
+        totalColors = 0;
+        for (std::size_t p = 0; p < numPalettes; p++) {
+            totalColors += palettes[p].size();
+            buildTable(p);
+        }
+        hashCounts.clear();
+        numUnique = 0;
+        for (TileState &tile : tileStates) {
+            tile.palette = firstPalette(palettes, tile.colors);
+            tile.hash = mergeSwaps && tile.palette >= 0 ? localHash(tile) : 0;
+            countTile(tile.hash, 1);
+        }
+        *numTiles = uniqueTiles();
+        *numFree = freeEntries();
+    }
+
+    // Hill climbing: tries moving each input, and the group of inputs in
+    // its palette linked to it by shared colours, to each other palette the
+    // colours fit in. Single moves alone rarely help, since the colours stay
+    // behind while other inputs use them. The first move that improves the
+    // score is kept. When none does, a move that leaves the score as it is
+    // is kept instead, so the search can cross flat stretches, and moving
+    // those inputs back is tabu for a while. Such moves only count if an
+    // improvement follows them; otherwise the palettes from before them are
+    // the result.
+    void optimize(PaletteOptimizeResult *result) {
+        result->movesTried = 0;
+        result->movesKept = 0;
+        kept = palettes;
+        std::vector<unsigned long> tabuUntil(inputs.size() * numPalettes, 0);
+        unsigned long step = 0;
+        unsigned long sideways = 0;
+        // Each scan starts where the last move was found, so the moves
+        // that just failed are not tried again first.
+        std::size_t first = 0;
+        while (true) {
+            findGroups();
+            std::vector<std::size_t> sidewaysMove;
+            std::size_t sidewaysTo = 0;
+            std::size_t sidewaysInput = 0;
+            bool improved = false;
+            for (std::size_t n = 0; n < inputs.size() && !improved; n++) {
+                std::size_t i = (first + n) % inputs.size();
+                std::vector<std::size_t> single(1, i);
+                std::vector<std::size_t> group;
+                for (std::size_t j = 0; j < inputs.size(); j++) {
+                    if (groups[j] == groups[i]) group.push_back(j);
+                }
+                for (const std::vector<std::size_t> *moved : {&single, &group}) {
+                    if (moved == &group && group.size() == 1) continue;
+                    ColorSet colors;
+                    for (std::size_t j : *moved) {
+                        colors |= inputs[j];
+                    }
+                    std::size_t from = assignment[i];
+                    for (std::size_t to = 0; to < numPalettes && !improved; to++) {
+                        if (to == from || (palettes[to] | colors).size() > maxSize) continue;
+                        if (result->movesTried >= PALETTE_OPTIMIZE_MAX_MOVES ||
+                            numRehashes >= PALETTE_OPTIMIZE_MAX_REHASHES) return;
+                        result->movesTried++;
+
+                        std::size_t tilesBefore = uniqueTiles(), colorsBefore = totalColors;
+                        bool covered = move(*moved, to);
+                        if (covered && (uniqueTiles() < tilesBefore ||
+                                        (uniqueTiles() == tilesBefore && totalColors < colorsBefore))) {
+                            setTabu(tabuUntil, *moved, from, ++step);
+                            first = i;
+                            improved = true;
+                        } else {
+                            if (covered && sidewaysMove.empty() && uniqueTiles() == tilesBefore &&
+                                totalColors == colorsBefore && !isTabu(tabuUntil, *moved, to, step)) {
+                                sidewaysMove = *moved;
+                                sidewaysTo = to;
+                                sidewaysInput = i;
+                            }
+                            undo(*moved, from);
+                        }
+                    }
+                    if (improved) break;
+                }
+            }
+
+            if (improved) {
+                result->movesKept += sideways + 1;
+                sideways = 0;
+                kept = palettes;
+            } else if (!sidewaysMove.empty() && sideways < PALETTE_OPTIMIZE_MAX_SIDEWAYS) {
+                std::size_t from = assignment[sidewaysMove[0]];
+                move(sidewaysMove, sidewaysTo);
+                setTabu(tabuUntil, sidewaysMove, from, ++step);
+                first = sidewaysInput;
+                sideways++;
+            } else {
+                break;
+            }
+        }
+    }
+
+    std::size_t uniqueTiles() const { return mergeSwaps ? numUnique : tileStates.size(); }
+    std::size_t freeEntries() const { return numPalettes * maxSize - totalColors; }
+    const std::vector<ColorSet> &result() const { return kept; }
+
+private:
+    struct TileState {
+        ColorSet colors;
+        unsigned char pixels[NUM_PIXELS_IN_TILE];
+        int palette;
+        uint64_t hash;
+    };
+
+    // A tile changed by a move, to put back if the move is undone.
+    struct Change {
+        std::size_t tile;
+        int palette;
+        uint64_t hash;
+    };
+
+    const std::vector<ColorSet> &inputs;
+    std::size_t numPalettes;
+    std::size_t maxSize;
+    bool mirrored;
+    bool mergeSwaps;
+    // counts[p * COLOR_SET_BITS + c] is the number of inputs in palette p using colour c.
+    std::vector<uint32_t> counts;
+    std::vector<ColorSet> palettes;
+    // The palettes after the last improving move.
+    std::vector<ColorSet> kept;
+    // Palette-local index of every colour, as PaletteMap assigns them.
+    std::vector<unsigned char> tables;
+    std::vector<std::size_t> assignment;
+    std::size_t totalColors;
+    std::vector<TileState> tileStates;
+    // How many tiles have each palette-local hash.
+    std::unordered_map<uint64_t, uint32_t> hashCounts;
+    std::size_t numUnique;
+    unsigned long numRehashes;
+    std::vector<Change> changes;
+    // Inputs with the same value share a palette and are linked by colours.
+    std::vector<int> groups;
+
+    static int firstPalette(const std::vector<ColorSet> &palettes, const ColorSet &colors) {
+        for (std::size_t p = 0; p < palettes.size(); p++) {
+            if (colors.isSubsetOf(palettes[p])) return (int) p;
+        }
+        return -1;
+    }
+
+    bool isTabu(const std::vector<unsigned long> &tabuUntil, const std::vector<std::size_t> &moved, std::size_t to,
+                unsigned long step) const {
+        for (std::size_t i : moved) {
+            if (tabuUntil[i * numPalettes + to] > step) return true;
+        }
+        return false;
+    }
+
+    // Bars moving the inputs back to palette from for the next few moves.
+    void setTabu(std::vector<unsigned long> &tabuUntil, const std::vector<std::size_t> &moved, std::size_t from,
+                 unsigned long step) const {
+        for (std::size_t i : moved) {
+            tabuUntil[i * numPalettes + from] = step + PALETTE_OPTIMIZE_TABU_TENURE;
+        }
+    }
+
+    static int findRoot(std::vector<int> &parent, int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    // Union-find over (palette, colour) pairs joined by each input. Colours
+    // held by more than one palette, such as a shared background colour,
+    // are left out, as in RepairSearch's warm start: they would join every
+    // input in a palette into one group that has nowhere better to go.
+    // Inputs made only of such colours are keyed by their first colour.
+    void findGroups() {
+        ColorSet seen, shared;
+        for (const ColorSet &palette : palettes) {
+            for (int w = 0; w < COLOR_SET_WORDS; w++) {
+                shared.words[w] |= seen.words[w] & palette.words[w];
+            }
+            seen |= palette;
+        }
+
+        std::vector<int> parent(numPalettes * COLOR_SET_BITS);
+        for (std::size_t x = 0; x < parent.size(); x++) {
+            parent[x] = (int) x;
+        }
+        std::vector<int> keys(inputs.size(), -1);
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            int base = (int) (assignment[i] * COLOR_SET_BITS);
+            std::vector<int> colors = inputs[i].colors();
+            for (int c : colors) {
+                if (shared.contains(c)) continue;
+                if (keys[i] < 0) {
+                    keys[i] = c;
+                } else {
+                    parent[findRoot(parent, base + c)] = findRoot(parent, base + keys[i]);
+                }
+            }
+            if (keys[i] < 0 && !colors.empty()) keys[i] = colors[0];
+        }
+        groups.assign(inputs.size(), -1);
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            if (keys[i] >= 0) {
+                groups[i] = findRoot(parent, (int) (assignment[i] * COLOR_SET_BITS) + keys[i]);
+            }
+        }
+    }
+
+    void addInput(std::size_t i, std::size_t p) {
+        for (int c : inputs[i].colors()) {
+            if (counts[p * COLOR_SET_BITS + c]++ == 0) {
+                palettes[p].insert(c);
+                totalColors++;
+            }
+        }
+    }
+
+    void removeInput(std::size_t i, std::size_t p) {
+        ColorSet freed;
+        for (int c : inputs[i].colors()) {
+            if (--counts[p * COLOR_SET_BITS + c] == 0) {
+                freed.insert(c);
+                totalColors--;
+            }
+        }
+        palettes[p].erase(freed);
+    }
+
+    void buildTable(std::size_t p) {
+        unsigned char *table = &tables[p * COLOR_SET_BITS];
+        int entry = 0;
+        for (int c = 0; c < COLOR_SET_BITS; c++) {
+            table[c] = (unsigned char) entry;
+            if (palettes[p].contains(c)) entry++;
+        }
+    }
+
+    uint64_t localHash(const TileState &state) const {
+        const unsigned char *table = &tables[(std::size_t) state.palette * COLOR_SET_BITS];
+        unsigned char local[NUM_PIXELS_IN_TILE];
+        for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
+            local[i] = table[state.pixels[i]];
+        }
+        Tile tile;
+        tile.setPixels(local);
+        if (!mirrored) {
+            return tile.hash();
+        }
+        TileAnalysis analysis;
+        tile.analyze(&analysis);
+        uint64_t planes[TILE_NUM_PLANES];
+        tile.orientation(analysis.canonicalTransform, planes);
+        return Tile::hashPlanes(planes);
+    }
+
+    void countTile(uint64_t hash, int delta) {
+        uint32_t &n = hashCounts[hash];
+        if (delta > 0 && n++ == 0) numUnique++;
+        if (delta < 0 && --n == 0) numUnique--;
+    }
+
+    // Moves a group of inputs sharing a palette to palette to and updates
+    // the tiles that affects. Returns false if a tile no longer fits any
+    // palette; undo() must follow.
+    bool move(const std::vector<std::size_t> &group, std::size_t to) {
+        std::size_t from = assignment[group[0]];
+        std::vector<unsigned char> oldFrom(&tables[from * COLOR_SET_BITS], &tables[(from + 1) * COLOR_SET_BITS]);
+        std::vector<unsigned char> oldTo(&tables[to * COLOR_SET_BITS], &tables[(to + 1) * COLOR_SET_BITS]);
+        for (std::size_t i : group) {
+            removeInput(i, from);
+            addInput(i, to);
+            assignment[i] = to;
+        }
+        buildTable(from);
+        buildTable(to);
+
+        changes.clear();
+        // Every tile stays covered by the input holding its colours, so
+        // without swap dedup only the colour count can change.
+        if (!mergeSwaps) return true;
+        bool covered = true;
+        for (std::size_t k = 0; k < tileStates.size(); k++) {
+            TileState &tile = tileStates[k];
+            std::size_t p = (std::size_t) tile.palette;
+            // Only the two changed palettes can lose a tile or renumber its
+            // colours, and only the grown one can take tiles from later ones.
+            if (p != from && p != to && !(p > to && tile.colors.isSubsetOf(palettes[to]))) continue;
+            int palette = firstPalette(palettes, tile.colors);
+            if (palette < 0) {
+                covered = false;
+                break;
+            }
+            if (palette == tile.palette && !renumbered(tile, p == from ? oldFrom : oldTo)) continue;
+
+            changes.push_back({k, tile.palette, tile.hash});
+            tile.palette = palette;
+            countTile(tile.hash, -1);
+            tile.hash = localHash(tile);
+            countTile(tile.hash, 1);
+            numRehashes++;
+        }
+        return covered;
+    }
+
+    // Whether any of the tile's colours has a new index in its palette.
+    bool renumbered(const TileState &tile, const std::vector<unsigned char> &oldTable) const {
+        const unsigned char *table = &tables[(std::size_t) tile.palette * COLOR_SET_BITS];
+        for (int c : tile.colors.colors()) {
+            if (table[c] != oldTable[c]) return true;
+        }
+        return false;
+    }
+
+    void undo(const std::vector<std::size_t> &group, std::size_t from) {
+        std::size_t to = assignment[group[0]];
+        for (std::size_t i : group) {
+            removeInput(i, to);
+            addInput(i, from);
+            assignment[i] = from;
+        }
+        buildTable(from);
+        buildTable(to);
+        for (std::size_t j = changes.size(); j-- > 0;) {
+            TileState &tile = tileStates[changes[j].tile];
+            countTile(tile.hash, -1);
+            countTile(changes[j].hash, 1);
+            tile.palette = changes[j].palette;
+            tile.hash = changes[j].hash;
+        }
+        changes.clear();
+    }
+};
+
+}
+
+std::vector<ColorSet> optimizePalettes(
+    const std::vector<ColorSet> &inputs,
+    const std::vector<ColorSet> &palettes,
+    const TileStore &tiles,
+    uint32_t firstTile,
+    std::size_t maxSize,
+    bool mirrored,
+    bool mergeSwaps,
+    PaletteOptimizeResult *result)
+{
+    PaletteOptimizer optimizer(inputs, tiles, firstTile, palettes.size(), maxSize, mirrored, mergeSwaps);
+    optimizer.score(palettes, &result->initialTiles, &result->initialFree);
+    result->finalTiles = result->initialTiles;
+    result->finalFree = result->initialFree;
+    result->movesTried = 0;
+    result->movesKept = 0;
+    if (!optimizer.reset(palettes)) {
+        return palettes;
+    }
+
+    optimizer.optimize(result);
+    result->finalTiles = optimizer.uniqueTiles();
+    result->finalFree = optimizer.freeEntries();
+    return optimizer.result();
+}
@@ -0,0 +1,63 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_PALETTEOPT_H
+#define PNG2TILE_PALETTEOPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "colorset.h"
+#include "tilestore.h"
+
+typedef struct {
+    // Tiles left after palette-swap dedup, before and after optimizing.
+    std::size_t initialTiles;
+    std::size_t finalTiles;
+    // Unused palette entries, before and after.
+    std::size_t initialFree;
+    std::size_t finalFree;
+    unsigned long movesTried;
+    unsigned long movesKept;
+} PaletteOptimizeResult;
+
+// Improves a feasible answer from reduceToNBuckets. inputs are the colour
+// sets it was given and palettes its answer; tiles from firstTile on are
+// the tiles that will be remapped to the palettes. Inputs are moved between
+// palettes while they still fit, keeping moves that lower the number of
+// unique tiles left by palette-swap dedup (when mergeSwaps is set), then
+// the number of palette entries used. Moves that change neither are also
+// kept for a while, with a tabu on moving back. Only the tiles whose palette-local
+// pixels can change are rehashed after a move.
+std::vector<ColorSet> optimizePalettes(
+    const std::vector<ColorSet> &inputs,
+    const std::vector<ColorSet> &palettes,
+    const TileStore &tiles,
+    uint32_t firstTile,
+    std::size_t maxSize,
+    bool mirrored,
+    bool mergeSwaps,
+    PaletteOptimizeResult *result);
+
+#endif //PNG2TILE_PALETTEOPT_H
@@ -0,0 +1,658 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "paralleldeflate.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_WINDOW 32768
+#define DEFLATE_WINDOW_MASK (DEFLATE_MAX_WINDOW - 1)
+#define DEFLATE_MAX_STORED 65535
+#define DEFLATE_MAX_BITS 15
+#define DEFLATE_MAX_CODE_LENGTH_BITS 7
+#define DEFLATE_END_OF_BLOCK 256
+// Literal/length symbols 286 and 287 and distance symbols 30 and 31 are
+// never used, but the fixed code still assigns them codes.
+#define DEFLATE_NUM_LITERALS 286
+#define DEFLATE_NUM_FIXED_LITERALS 288
+#define DEFLATE_NUM_DISTANCES 30
+#define DEFLATE_NUM_CODE_LENGTHS 19
+#define MATCH_HASH_BITS 15
+// zlib's level 9 limits: chains are cut at MATCH_MAX_CHAIN links, and at a
+// quarter of that once a match of MATCH_GOOD_LENGTH is found.
+#define MATCH_MAX_CHAIN 4096
+#define MATCH_GOOD_LENGTH 32
+// Largest number of bytes whose Adler-32 sums cannot overflow 32 bits.
+#define ADLER_BLOCK_SIZE 5552
+#define ADLER_MODULUS 65521
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char CODE_LENGTH_ORDER[DEFLATE_NUM_CODE_LENGTHS] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Symbol lookups for match lengths and distances. Distances above 256 are
+// looked up by their top bits, as their codes cover multiples of 128.
+typedef struct {
+    unsigned char lengthCodes[DEFLATE_MAX_MATCH + 1];
+    unsigned char distanceCodes[512];
+} CodeTables;
+
+static CodeTables make_code_tables() {
+    CodeTables tables;
+    for (int code = 0; code < 29; code++) {
+        for (int length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]) &&
+                                             length <= DEFLATE_MAX_MATCH; length++) {
+            tables.lengthCodes[length] = (unsigned char) code;
+        }
+    }
+    // 258 has a code of its own rather than being 227 + 31.
+    tables.lengthCodes[DEFLATE_MAX_MATCH] = 28;
+    for (int code = 0; code < 30; code++) {
+        for (int distance = DISTANCE_BASE[code]; distance < DISTANCE_BASE[code] + (1 << DISTANCE_EXTRA[code]); distance++) {
+            int index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+            tables.distanceCodes[index] = (unsigned char) code;
+        }
+    }
+    return tables;
+}
+
+static const CodeTables &code_tables() {
+    static const CodeTables tables = make_code_tables();
+    return tables;
+}
+
+static int distance_code(const CodeTables &tables, int distance) {
+    return tables.distanceCodes[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char> *out) : out(out), buffer(0), count(0) {
+    }
+
+    // Appends the low bits of value, least significant first.
+    void put(uint32_t value, int bits) {
+        buffer |= (uint64_t) value << count;
+        count += bits;
+        while (count >= 8) {
+            out->push_back((unsigned char) buffer);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    void align() {
+        if (count > 0) {
+            out->push_back((unsigned char) buffer);
+            buffer = 0;
+            count = 0;
+        }
+    }
+
+    // Only valid after align().
+    void bytes(const unsigned char *data, std::size_t size) {
+        out->insert(out->end(), data, data + size);
+    }
+
+private:
+    std::vector<unsigned char> *out;
+    uint64_t buffer;
+    int count;
+};
+
+typedef struct {
+    unsigned char lengths[DEFLATE_NUM_FIXED_LITERALS];
+    // Canonical codes, bit-reversed so they can be written least significant
+    // bit first.
+    uint16_t codes[DEFLATE_NUM_FIXED_LITERALS];
+} HuffmanCode;
+
+// Huffman code lengths of at most maxBits for the symbols' frequencies. At
+// least two symbols get a code, so the code is always complete.
+static void build_code_lengths(const uint32_t *freqs, int numSymbols, int maxBits, unsigned char *lengths) {
+    std::vector<int> symbols;
+    std::vector<uint32_t> weights(numSymbols);
+    for (int i = 0; i < numSymbols; i++) {
+        weights[i] = freqs[i];
+        if (freqs[i] != 0) {
+            symbols.push_back(i);
+        }
+    }
+    for (int i = 0; symbols.size() < 2; i++) {
+        if (weights[i] == 0) {
+            weights[i] = 1;
+            symbols.push_back(i);
+        }
+    }
+    std::sort(symbols.begin(), symbols.end(), [&](int a, int b) {
+        return weights[a] != weights[b] ? weights[a] < weights[b] : a < b;
+    });
+
+    // Two-queue Huffman construction over the sorted leaves: internal nodes
+    // are created in order of weight, so the next smallest node is at the
+    // front of one of the two queues.
+    int numLeaves = (int) symbols.size();
+    std::vector<uint64_t> nodeWeights(2 * numLeaves - 1);
+    std::vector<int> parents(2 * numLeaves - 1, 0);
+    for (int i = 0; i < numLeaves; i++) {
+        nodeWeights[i] = weights[symbols[i]];
+    }
+    int nextLeaf = 0;
+    int nextInternal = numLeaves;
+    for (int node = numLeaves; node < 2 * numLeaves - 1; node++) {
+        int children[2];
+        for (int &child : children) {
+            if (nextLeaf < numLeaves && (nextInternal == node || nodeWeights[nextLeaf] <= nodeWeights[nextInternal])) {
+                child = nextLeaf++;
+            } else {
+                child = nextInternal++;
+            }
+            parents[child] = node;
+        }
+        nodeWeights[node] = nodeWeights[children[0]] + nodeWeights[children[1]];
+    }
+    std::vector<int> depths(2 * numLeaves - 1, 0);
+    for (int node = 2 * numLeaves - 3; node >= 0; node--) {
+        depths[node] = depths[parents[node]] + 1;
+    }
+
+    // Clamp to maxBits, then lengthen the deepest codes that still fit until
+    // the lengths describe a complete code again.
+    int counts[DEFLATE_MAX_BITS + 1] = {0};
+    for (int i = 0; i < numLeaves; i++) {
+        counts[std::min(depths[i], maxBits)]++;
+    }
+    uint32_t total = 0;
+    for (int len = 1; len <= maxBits; len++) {
+        total += (uint32_t) counts[len] << (maxBits - len);
+    }
+    while (total > (1u << maxBits)) {
+        counts[maxBits]--;
+        for (int len = maxBits - 1; len > 0; len--) {
+            if (counts[len] != 0) {
+                counts[len]--;
+                counts[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // The most frequent symbols take the shortest codes.
+    memset(lengths, 0, (std::size_t) numSymbols);
+    int next = numLeaves - 1;
+    for (int len = 1; len <= maxBits; len++) {
+        for (int i = 0; i < counts[len]; i++) {
+            lengths[symbols[next--]] = (unsigned char) len;
+        }
+    }
+}
+
+static void build_codes(HuffmanCode *code, int numSymbols) {
+    int counts[DEFLATE_MAX_BITS + 1] = {0};
+    for (int i = 0; i < numSymbols; i++) {
+        counts[code->lengths[i]]++;
+    }
+    counts[0] = 0;
+    uint32_t nextCode[DEFLATE_MAX_BITS + 1];
+    uint32_t value = 0;
+    for (int len = 1; len <= DEFLATE_MAX_BITS; len++) {
+        value = (value + counts[len - 1]) << 1;
+        nextCode[len] = value;
+    }
+    for (int i = 0; i < numSymbols; i++) {
+        int len = code->lengths[i];
+        if (len == 0) {
+            continue;
+        }
+        uint32_t canonical = nextCode[len]++;
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < len; bit++, canonical >>= 1) {
+            reversed = (reversed << 1) | (canonical & 1);
+        }
+        code->codes[i] = (uint16_t) reversed;
+    }
+}
+
+// An LZ77 symbol: a literal byte when length is 0, otherwise a match.
+typedef struct {
+    uint16_t length;
+    uint16_t value;
+} Token;
+
+static void write_tokens(BitWriter *writer, const CodeTables &tables, const Token *tokens, std::size_t numTokens,
+                         const HuffmanCode &literals, const HuffmanCode &distances) {
+    for (std::size_t i = 0; i < numTokens; i++) {
+        const Token &token = tokens[i];
+        if (token.length == 0) {
+            writer->put(literals.codes[token.value], literals.lengths[token.value]);
+            continue;
+        }
+        int lengthCode = tables.lengthCodes[token.length];
+        writer->put(literals.codes[257 + lengthCode], literals.lengths[257 + lengthCode]);
+        writer->put(token.length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+        int distanceCode = distance_code(tables, token.value);
+        writer->put(distances.codes[distanceCode], distances.lengths[distanceCode]);
+        writer->put(token.value - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+    }
+    writer->put(literals.codes[DEFLATE_END_OF_BLOCK], literals.lengths[DEFLATE_END_OF_BLOCK]);
+}
+
+static void write_fixed_block(BitWriter *writer, const CodeTables &tables, const Token *tokens, std::size_t numTokens,
+                              bool final) {
+    HuffmanCode literals;
+    HuffmanCode distances;
+    memset(literals.lengths, 8, 144);
+    memset(literals.lengths + 144, 9, 112);
+    memset(literals.lengths + 256, 7, 24);
+    memset(literals.lengths + 280, 8, DEFLATE_NUM_FIXED_LITERALS - 280);
+    memset(distances.lengths, 5, DEFLATE_NUM_DISTANCES);
+    build_codes(&literals, DEFLATE_NUM_FIXED_LITERALS);
+    build_codes(&distances, DEFLATE_NUM_DISTANCES);
+
+    writer->put(final ? 1 : 0, 1);
+    writer->put(1, 2);
+    write_tokens(writer, tables, tokens, numTokens, literals, distances);
+}
+
+static void write_dynamic_block(BitWriter *writer, const CodeTables &tables, const Token *tokens, std::size_t numTokens,
+                                bool final) {
+    uint32_t literalFreqs[DEFLATE_NUM_LITERALS] = {0};
+    uint32_t distanceFreqs[DEFLATE_NUM_DISTANCES] = {0};
+    literalFreqs[DEFLATE_END_OF_BLOCK] = 1;
+    for (std::size_t i = 0; i < numTokens; i++) {
+        if (tokens[i].length == 0) {
+            literalFreqs[tokens[i].value]++;
+        } else {
+            literalFreqs[257 + tables.lengthCodes[tokens[i].length]]++;
+            distanceFreqs[distance_code(tables, tokens[i].value)]++;
+        }
+    }
+
+    HuffmanCode literals;
+    HuffmanCode distances;
+    build_code_lengths(literalFreqs, DEFLATE_NUM_LITERALS, DEFLATE_MAX_BITS, literals.lengths);
+    build_code_lengths(distanceFreqs, DEFLATE_NUM_DISTANCES, DEFLATE_MAX_BITS, distances.lengths);
+    build_codes(&literals, DEFLATE_NUM_LITERALS);
+    build_codes(&distances, DEFLATE_NUM_DISTANCES);
+
+    int numLiterals = DEFLATE_NUM_LITERALS;
+    while (numLiterals > 257 && literals.lengths[numLiterals - 1] == 0) {
+        numLiterals--;
+    }
+    int numDistances = DEFLATE_NUM_DISTANCES;
+    while (numDistances > 1 && distances.lengths[numDistances - 1] == 0) {
+        numDistances--;
+    }
+
+    // Both sets of lengths are sent as one sequence, run-length coded with
+    // symbols 16 (repeat the previous length), 17 and 18 (runs of zeros).
+    unsigned char lengths[DEFLATE_NUM_LITERALS + DEFLATE_NUM_DISTANCES];
+    memcpy(lengths, literals.lengths, (std::size_t) numLiterals);
+    memcpy(lengths + numLiterals, distances.lengths, (std::size_t) numDistances);
+    int total = numLiterals + numDistances;
+    std::vector<std::pair<int, int>> runs;
+    uint32_t codeLengthFreqs[DEFLATE_NUM_CODE_LENGTHS] = {0};
+    for (int i = 0; i < total;) {
+        int value = lengths[i];
+        int run = 1;
+        while (i + run < total && lengths[i + run] == value) {
+            run++;
+        }
+        i += run;
+        if (value == 0) {
+            while (run >= 11) {
+                int n = std::min(run, 138);
+                runs.push_back(std::make_pair(18, n - 11));
+                run -= n;
+            }
+            if (run >= 3) {
+                runs.push_back(std::make_pair(17, run - 3));
+                run = 0;
+            }
+        } else {
+            runs.push_back(std::make_pair(value, 0));
+            run--;
+            while (run >= 3) {
+                int n = std::min(run, 6);
+                runs.push_back(std::make_pair(16, n - 3));
+                run -= n;
+            }
+        }
+        for (; run > 0; run--) {
+            runs.push_back(std::make_pair(value, 0));
+        }
+    }
+    for (const std::pair<int, int> &run : runs) {
+        codeLengthFreqs[run.first]++;
+    }
+
+    HuffmanCode codeLengths;
+    build_code_lengths(codeLengthFreqs, DEFLATE_NUM_CODE_LENGTHS, DEFLATE_MAX_CODE_LENGTH_BITS, codeLengths.lengths);
+    build_codes(&codeLengths, DEFLATE_NUM_CODE_LENGTHS);
+    int numCodeLengths = DEFLATE_NUM_CODE_LENGTHS;
+    while (numCodeLengths > 4 && codeLengths.lengths[CODE_LENGTH_ORDER[numCodeLengths - 1]] == 0) {
+        numCodeLengths--;
+    }
+
+    writer->put(final ? 1 : 0, 1);
+    writer->put(2, 2);
+    writer->put((uint32_t) (numLiterals - 257), 5);
+    writer->put((uint32_t) (numDistances - 1), 5);
+    writer->put((uint32_t) (numCodeLengths - 4), 4);
+    for (int i = 0; i < numCodeLengths; i++) {
+        writer->put(codeLengths.lengths[CODE_LENGTH_ORDER[i]], 3);
+    }
+    for (const std::pair<int, int> &run : runs) {
+        writer->put(codeLengths.codes[run.first], codeLengths.lengths[run.first]);
+        if (run.first == 16) {
+            writer->put((uint32_t) run.second, 2);
+        } else if (run.first == 17) {
+            writer->put((uint32_t) run.second, 3);
+        } else if (run.first == 18) {
+            writer->put((uint32_t) run.second, 7);
+        }
+    }
+    write_tokens(writer, tables, tokens, numTokens, literals, distances);
+}
+
+// Hash chains over the input. Small windows cut chains at windowsize / 8
+// links as lodepng does; large windows use zlib's limits instead of
+// lodepng's full windowsize, which crawls through long runs of one colour.
+class Matcher {
+public:
+    Matcher(const unsigned char *in, std::size_t insize, const LodePNGCompressSettings *settings)
+        : in(in), insize(insize), head((std::size_t) 1 << MATCH_HASH_BITS), prev(DEFLATE_MAX_WINDOW),
+          windowSize(settings->windowsize), minMatch(std::max(3u, settings->minmatch)),
+          niceMatch(std::min((unsigned) DEFLATE_MAX_MATCH, settings->nicematch)),
+          maxChain(settings->windowsize >= 8192 ? MATCH_MAX_CHAIN : settings->windowsize / 8) {
+    }
+
+    void reset() {
+        std::fill(head.begin(), head.end(), -1);
+    }
+
+    void insert(std::size_t pos) {
+        if (pos + 2 >= insize) {
+            return;
+        }
+        uint32_t hash = hashAt(pos);
+        prev[pos & DEFLATE_WINDOW_MASK] = head[hash];
+        head[hash] = (int64_t) pos;
+    }
+
+    // The longest match for pos that ends by end, or 0. pos itself must not
+    // have been inserted yet.
+    unsigned find(std::size_t pos, std::size_t end, unsigned *distance) const {
+        std::size_t limit = std::min((std::size_t) DEFLATE_MAX_MATCH, end - pos);
+        if (limit < minMatch || pos + 2 >= insize) {
+            return 0;
+        }
+        unsigned best = minMatch - 1;
+        unsigned chain = 0;
+        unsigned chainLimit = maxChain;
+        for (int64_t candidate = head[hashAt(pos)]; candidate >= 0; chain++) {
+            std::size_t c = (std::size_t) candidate;
+            if (pos - c > windowSize || chain >= chainLimit) {
+                break;
+            }
+            if (in[c + best] == in[pos + best]) {
+                unsigned len = 0;
+                while (len < limit && in[c + len] == in[pos + len]) {
+                    len++;
+                }
+                if (len > best) {
+                    best = len;
+                    *distance = (unsigned) (pos - c);
+                    if (len >= niceMatch || len == limit) {
+                        break;
+                    }
+                    if (len >= MATCH_GOOD_LENGTH && maxChain == MATCH_MAX_CHAIN) {
+                        chainLimit = maxChain / 4;
+                    }
+                }
+            }
+            int64_t next = prev[c & DEFLATE_WINDOW_MASK];
+            if (next >= candidate) {
+                break;
+            }
+            candidate = next;
+        }
+        return best >= minMatch ? best : 0;
+    }
+
+private:
+    uint32_t hashAt(std::size_t pos) const {
+        uint32_t bytes = ((uint32_t) in[pos] << 16) | ((uint32_t) in[pos + 1] << 8) | in[pos + 2];
+        return (bytes * 2654435761u) >> (32 - MATCH_HASH_BITS);
+    }
+
+    const unsigned char *in;
+    std::size_t insize;
+    std::vector<int64_t> head;
+    std::vector<int64_t> prev;
+    unsigned windowSize;
+    unsigned minMatch;
+    unsigned niceMatch;
+    unsigned maxChain;
+};
+
+static void tokenize(Matcher *matcher, const unsigned char *in, std::size_t start, std::size_t end,
+                     const LodePNGCompressSettings *settings, std::vector<Token> *tokens) {
+    unsigned maxLazyMatch = settings->windowsize >= 8192 ? DEFLATE_MAX_MATCH : 64;
+    std::size_t pos = start;
+    while (pos < end) {
+        unsigned distance = 0;
+        unsigned length = matcher->find(pos, end, &distance);
+        matcher->insert(pos);
+
+        // Prefer a literal here if the next position starts a longer match.
+        if (settings->lazymatching && length != 0 && length < maxLazyMatch && pos + 1 < end) {
+            unsigned nextDistance = 0;
+            unsigned nextLength = matcher->find(pos + 1, end, &nextDistance);
+            if (nextLength > length) {
+                Token literal = {0, in[pos]};
+                tokens->push_back(literal);
+                pos++;
+                matcher->insert(pos);
+                length = nextLength;
+                distance = nextDistance;
+            }
+        }
+
+        if (length != 0) {
+            Token match = {(uint16_t) length, (uint16_t) distance};
+            tokens->push_back(match);
+            for (std::size_t i = pos + 1; i < pos + length; i++) {
+                matcher->insert(i);
+            }
+            pos += length;
+        } else {
+            Token literal = {0, in[pos]};
+            tokens->push_back(literal);
+            pos++;
+        }
+    }
+}
+
+// Deflates in[start, end) into out. Every chunk but the last finishes on a
+// byte boundary with no final block, so chunks can be concatenated.
+static void deflate_chunk(Matcher *matcher, const unsigned char *in, std::size_t start, std::size_t end, bool last,
+                          const LodePNGCompressSettings *settings, std::vector<unsigned char> *out) {
+    BitWriter writer(out);
+
+    if (settings->btype == 0) {
+        std::size_t pos = start;
+        do {
+            std::size_t size = std::min((std::size_t) DEFLATE_MAX_STORED, end - pos);
+            writer.put(last && pos + size == end ? 1 : 0, 1);
+            writer.put(0, 2);
+            writer.align();
+            writer.put((uint32_t) size, 16);
+            writer.put((uint32_t) (size ^ 0xFFFF), 16);
+            writer.bytes(in + pos, size);
+            pos += size;
+        } while (pos < end);
+        return;
+    }
+
+    std::vector<Token> tokens;
+    tokens.reserve(end - start);
+    if (settings->use_lz77) {
+        matcher->reset();
+        std::size_t dictionaryStart = start > settings->windowsize ? start - settings->windowsize : 0;
+        for (std::size_t pos = dictionaryStart; pos < start; pos++) {
+            matcher->insert(pos);
+        }
+        tokenize(matcher, in, start, end, settings, &tokens);
+    } else {
+        for (std::size_t pos = start; pos < end; pos++) {
+            Token literal = {0, in[pos]};
+            tokens.push_back(literal);
+        }
+    }
+
+    const CodeTables &tables = code_tables();
+    std::size_t first = 0;
+    do {
+        std::size_t count = std::min((std::size_t) PARALLEL_DEFLATE_BLOCK_SYMBOLS, tokens.size() - first);
+        bool final = last && first + count == tokens.size();
+        const Token *blockTokens = tokens.empty() ? nullptr : &tokens[first];
+        if (settings->btype == 1) {
+            write_fixed_block(&writer, tables, blockTokens, count, final);
+        } else {
+            write_dynamic_block(&writer, tables, blockTokens, count, final);
+        }
+        first += count;
+    } while (first < tokens.size());
+
+    if (!last) {
+        // An empty stored block brings the chunk to a byte boundary.
+        writer.put(0, 3);
+        writer.align();
+        writer.put(0, 16);
+        writer.put(0xFFFF, 16);
+    }
+    writer.align();
+}
+
+static uint32_t adler32(const unsigned char *data, std::size_t size) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (std::size_t i = 0; i < size;) {
+        std::size_t end = std::min(i + ADLER_BLOCK_SIZE, size);
+        for (; i < end; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= ADLER_MODULUS;
+        b %= ADLER_MODULUS;
+    }
+    return (b << 16) | a;
+}
+
+unsigned parallel_zlib_compress(unsigned char **out, std::size_t *outsize, const unsigned char *in,
+                                std::size_t insize, const LodePNGCompressSettings *settings) {
+    if (settings->btype > 2) {
+        return 61;
+    }
+    if (settings->windowsize == 0 || settings->windowsize > DEFLATE_MAX_WINDOW) {
+        return 60;
+    }
+    if ((settings->windowsize & (settings->windowsize - 1)) != 0) {
+        return 90;
+    }
+
+    std::size_t numChunks = std::max((std::size_t) 1, (insize + PARALLEL_DEFLATE_CHUNK_SIZE - 1) / PARALLEL_DEFLATE_CHUNK_SIZE);
+    int numThreads = settings->custom_context != nullptr ? *(const int *) settings->custom_context : 1;
+    numThreads = (int) std::min((std::size_t) std::max(1, numThreads), numChunks);
+
+    std::vector<std::vector<unsigned char>> chunks(numChunks);
+    std::atomic<std::size_t> nextChunk(0);
+    auto deflate_chunks = [&]() {
+        Matcher matcher(in, insize, settings);
+        for (std::size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+            std::size_t start = chunk * PARALLEL_DEFLATE_CHUNK_SIZE;
+            std::size_t end = std::min(start + PARALLEL_DEFLATE_CHUNK_SIZE, insize);
+            deflate_chunk(&matcher, in, start, end, chunk == numChunks - 1, settings, &chunks[chunk]);
+        }
+    };
+
+    if (numThreads == 1) {
+        deflate_chunks();
+    } else {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++) {
+            threads.emplace_back(deflate_chunks);
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    // The zlib header lodepng writes, the chunks, then the Adler-32.
+    std::size_t size = 2 + 4;
+    for (const std::vector<unsigned char> &chunk : chunks) {
+        size += chunk.size();
+    }
+    unsigned char *result = (unsigned char *) malloc(size);
+    if (result == nullptr) {
+        return 83;
+    }
+    result[0] = 0x78;
+    result[1] = 0x01;
+    std::size_t pos = 2;
+    for (const std::vector<unsigned char> &chunk : chunks) {
+        if (!chunk.empty()) {
+            memcpy(result + pos, &chunk[0], chunk.size());
+            pos += chunk.size();
+        }
+    }
+    uint32_t adler = adler32(in, insize);
+    for (int i = 0; i < 4; i++) {
+        result[pos++] = (unsigned char) (adler >> (24 - 8 * i));
+    }
+
+    *out = result;
+    *outsize = size;
+    return 0;
+}
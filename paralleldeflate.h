@@ -0,0 +1,50 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_PARALLELDEFLATE_H
+#define PNG2TILE_PARALLELDEFLATE_H
+
+#include <cstddef>
+
+#include "lodepng.h"
+
+// Uncompressed bytes per independently deflated chunk.
+#define PARALLEL_DEFLATE_CHUNK_SIZE (128 * 1024)
+// LZ77 symbols per dynamic Huffman block within a chunk.
+#define PARALLEL_DEFLATE_BLOCK_SYMBOLS 32768
+
+// A lodepng custom_zlib that deflates the input in PARALLEL_DEFLATE_CHUNK_SIZE
+// chunks on several threads, in the style of pigz. Each chunk's matches may
+// reach back into the previous chunk, as if its dictionary were primed, and
+// every chunk but the last ends with an empty stored block so that it stops
+// on a byte boundary. The chunks then join into one zlib stream. The output
+// does not depend on the number of threads.
+//
+// settings->custom_context points to the int number of threads, or is null
+// for one. btype, use_lz77, windowsize, minmatch, nicematch and
+// lazymatching are honoured, though windows of 8192 and up search zlib's
+// level 9 chain lengths rather than lodepng's.
+unsigned parallel_zlib_compress(unsigned char **out, std::size_t *outsize, const unsigned char *in,
+                                std::size_t insize, const LodePNGCompressSettings *settings);
+
+#endif //PNG2TILE_PARALLELDEFLATE_H
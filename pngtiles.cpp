@@ -0,0 +1,301 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pngtiles.h"
+#include "lodepng.h"
+
+#include <cstdint>
+#include <cstring>
+
+#define PNG_SIGNATURE_SIZE 8
+// Signature, then the IHDR chunk: length, type, 13 data bytes and CRC.
+#define PNG_HEADER_SIZE 33
+#define PNG_CHUNK_OVERHEAD 12
+#define PNG_MAX_CHUNK_LENGTH 2147483647u
+
+static const unsigned char PNG_SIGNATURE[PNG_SIGNATURE_SIZE] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static uint32_t read_be32(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static unsigned char paeth_predictor(int a, int b, int c) {
+    int pa = b > c ? b - c : c - b;
+    int pb = a > c ? a - c : c - a;
+    int pc = a + b - 2 * c;
+    if (pc < 0) {
+        pc = -pc;
+    }
+    if (pc < pa && pc < pb) {
+        return (unsigned char) c;
+    }
+    return (unsigned char) (pb < pa ? b : a);
+}
+
+// Reverses one scanline's filter in place. Indexed pixels are at most a byte
+// wide, so the left neighbour is always the previous byte. prev is the
+// previous unfiltered scanline, or null for the first.
+static unsigned unfilter_scanline(unsigned char *line, const unsigned char *prev, std::size_t length,
+                                  unsigned char filterType) {
+    switch (filterType) {
+        case 0:
+            break;
+        case 1:
+            for (std::size_t i = 1; i < length; i++) {
+                line[i] += line[i - 1];
+            }
+            break;
+        case 2:
+            if (prev != nullptr) {
+                for (std::size_t i = 0; i < length; i++) {
+                    line[i] += prev[i];
+                }
+            }
+            break;
+        case 3:
+            if (prev != nullptr) {
+                line[0] += prev[0] >> 1;
+                for (std::size_t i = 1; i < length; i++) {
+                    line[i] += (unsigned char) ((line[i - 1] + prev[i]) >> 1);
+                }
+            } else {
+                for (std::size_t i = 1; i < length; i++) {
+                    line[i] += line[i - 1] >> 1;
+                }
+            }
+            break;
+        case 4:
+            if (prev != nullptr) {
+                line[0] += prev[0];
+                for (std::size_t i = 1; i < length; i++) {
+                    line[i] += paeth_predictor(line[i - 1], prev[i], prev[i - 1]);
+                }
+            } else {
+                for (std::size_t i = 1; i < length; i++) {
+                    line[i] += line[i - 1];
+                }
+            }
+            break;
+        default:
+            return 36;
+    }
+    return 0;
+}
+
+// Writes scanline y of packed bitDepth-bit pixels into band's blocks. y
+// counts from the top of the band.
+static void scatter_scanline(const unsigned char *line, unsigned int bitDepth, unsigned int y, Image *band) {
+    const std::size_t blockPixels = IMAGE_BLOCK_SIZE * IMAGE_BLOCK_SIZE;
+    unsigned char *dst = &band->pixels[image_block_offset(band, 0, y) + (y % IMAGE_BLOCK_SIZE) * IMAGE_BLOCK_SIZE];
+    unsigned int x = 0;
+
+    if (bitDepth == 8) {
+        for (; x + IMAGE_BLOCK_SIZE <= band->width; x += IMAGE_BLOCK_SIZE, dst += blockPixels) {
+            memcpy(dst, line + x, IMAGE_BLOCK_SIZE);
+        }
+        for (unsigned int i = 0; x < band->width; x++, i++) {
+            dst[i] = line[x];
+        }
+        return;
+    }
+
+    unsigned int pixelsPerByte = 8 / bitDepth;
+    unsigned char mask = (unsigned char) ((1u << bitDepth) - 1);
+    for (std::size_t i = 0; x < band->width; i++) {
+        unsigned char byte = line[i];
+        for (unsigned int k = 0; k < pixelsPerByte && x < band->width; k++, x++) {
+            dst[(x / IMAGE_BLOCK_SIZE) * blockPixels + x % IMAGE_BLOCK_SIZE] =
+                (unsigned char) ((byte >> (8 - bitDepth * (k + 1))) & mask);
+        }
+    }
+}
+
+static std::size_t block_row_size(unsigned int width) {
+    return (std::size_t) image_blocks_wide(width) * IMAGE_BLOCK_SIZE * IMAGE_BLOCK_SIZE;
+}
+
+PngTileReader::PngTileReader() : imageWidth(0), imageHeight(0), bitDepth(0), lineBytes(0), nextRow(0) {
+}
+
+PngTileReader::~PngTileReader() {
+}
+
+// Adam7 passes are not whole scanlines, so lodepng deinterlaces into
+// row-major 8-bit indices, which are then scattered like 8-bit scanlines.
+unsigned PngTileReader::openInterlaced(const unsigned char *png, std::size_t size) {
+    lodepng::State state;
+    state.info_raw.colortype = LCT_PALETTE;
+    state.info_raw.bitdepth = 8;
+    std::vector<unsigned char> rows;
+    unsigned error = lodepng::decode(rows, imageWidth, imageHeight, state, png, size);
+    if (error) {
+        return error;
+    }
+
+    for (std::size_t i = 0; i < state.info_png.color.palettesize; i++) {
+        const unsigned char *c = &state.info_png.color.palette[i * 4];
+        imagePalette.push_back(Color(c[0], c[1], c[2]));
+    }
+    Image image;
+    image.width = imageWidth;
+    image.height = imageHeight;
+    std::size_t blocksHigh = (imageHeight + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE;
+    image.pixels.assign(blocksHigh * block_row_size(imageWidth), 0);
+    for (unsigned int y = 0; y < imageHeight; y++) {
+        scatter_scanline(&rows[(std::size_t) y * imageWidth], 8, y, &image);
+    }
+    interlacedPixels.swap(image.pixels);
+    return 0;
+}
+
+unsigned PngTileReader::open(const unsigned char *png, std::size_t size) {
+    if (png == nullptr || size == 0) {
+        return 48;
+    }
+    if (size < PNG_HEADER_SIZE) {
+        return 27;
+    }
+    if (memcmp(png, PNG_SIGNATURE, PNG_SIGNATURE_SIZE) != 0) {
+        return 28;
+    }
+    if (memcmp(png + 12, "IHDR", 4) != 0) {
+        return 29;
+    }
+    if (read_be32(png + 8) != 13) {
+        return 94;
+    }
+    if (lodepng_chunk_check_crc(png + 8)) {
+        return 57;
+    }
+
+    imageWidth = read_be32(png + 16);
+    imageHeight = read_be32(png + 20);
+    bitDepth = png[24];
+    if (imageWidth == 0 || imageHeight == 0) {
+        return 93;
+    }
+    if (png[25] != LCT_PALETTE) {
+        return 31;
+    }
+    if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8) {
+        return 37;
+    }
+    if (png[26] != 0) {
+        return 32;
+    }
+    if (png[27] != 0) {
+        return 33;
+    }
+    if (png[28] > 1) {
+        return 34;
+    }
+    if (png[28] == 1) {
+        return openInterlaced(png, size);
+    }
+
+    // Collect the palette and where the IDAT data lies; it is inflated
+    // from there as rows are read.
+    std::vector<InflateSegment> segments;
+    const unsigned char *end = png + size;
+    const unsigned char *chunk = png + PNG_HEADER_SIZE;
+    while ((std::size_t) (end - chunk) >= PNG_CHUNK_OVERHEAD) {
+        unsigned length = lodepng_chunk_length(chunk);
+        if (length > PNG_MAX_CHUNK_LENGTH) {
+            return 63;
+        }
+        if ((std::size_t) (end - chunk) - PNG_CHUNK_OVERHEAD < length) {
+            return 30;
+        }
+        if (lodepng_chunk_check_crc(chunk)) {
+            return 57;
+        }
+
+        const unsigned char *data = lodepng_chunk_data_const(chunk);
+        if (lodepng_chunk_type_equals(chunk, "IEND")) {
+            break;
+        } else if (lodepng_chunk_type_equals(chunk, "PLTE")) {
+            if (length == 0 || length % 3 != 0 || length / 3 > 256) {
+                return 38;
+            }
+            imagePalette.clear();
+            for (unsigned i = 0; i < length; i += 3) {
+                imagePalette.push_back(Color(data[i], data[i + 1], data[i + 2]));
+            }
+        } else if (lodepng_chunk_type_equals(chunk, "IDAT")) {
+            InflateSegment segment = {data, length};
+            segments.push_back(segment);
+        } else if (!lodepng_chunk_ancillary(chunk)) {
+            return 69;
+        }
+        chunk += PNG_CHUNK_OVERHEAD + length;
+    }
+    if (imagePalette.empty()) {
+        return 106;
+    }
+
+    inflater.reset(new InflateStream(segments));
+    lineBytes = ((std::size_t) imageWidth * bitDepth + 7) / 8;
+    lines.assign(2 * (lineBytes + 1), 0);
+    return 0;
+}
+
+unsigned PngTileReader::readBlockRows(unsigned int numRows, Image *band) {
+    unsigned int firstRow = nextRow;
+    unsigned int lastRow = firstRow + numRows * IMAGE_BLOCK_SIZE;
+    if (lastRow > imageHeight || lastRow < firstRow) {
+        lastRow = imageHeight;
+    }
+    band->width = imageWidth;
+    band->height = lastRow - firstRow;
+    std::size_t bandSize = (band->height + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE * block_row_size(imageWidth);
+
+    if (!interlacedPixels.empty()) {
+        const unsigned char *src = &interlacedPixels[firstRow / IMAGE_BLOCK_SIZE * block_row_size(imageWidth)];
+        band->pixels.assign(src, src + bandSize);
+        nextRow = lastRow;
+        return 0;
+    }
+
+    band->pixels.assign(bandSize, 0);
+    if (inflater == nullptr) {
+        return band->height == 0 ? 0 : 1;
+    }
+    std::size_t stride = lineBytes + 1;
+    for (unsigned int y = firstRow; y < lastRow; y++) {
+        // Rows alternate between the two scanline buffers.
+        unsigned char *line = &lines[(y % 2) * stride];
+        const unsigned char *prev = y == 0 ? nullptr : &lines[((y + 1) % 2) * stride] + 1;
+        unsigned error = inflater->read(line, stride);
+        if (!error) error = unfilter_scanline(line + 1, prev, lineBytes, line[0]);
+        if (error) {
+            return error;
+        }
+        scatter_scanline(line + 1, bitDepth, y - firstRow, band);
+    }
+    nextRow = lastRow;
+    if (firstRow < lastRow && lastRow == imageHeight) {
+        return inflater->finish();
+    }
+    return 0;
+}
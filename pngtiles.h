@@ -0,0 +1,75 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_PNGTILES_H
+#define PNG2TILE_PNGTILES_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "image.h"
+#include "inflatestream.h"
+
+// Decodes an indexed PNG into tile-major pixels a band of block rows at a
+// time, so memory use scales with the image's width rather than its area.
+// Scanlines are inflated and unfiltered one at a time and scattered into
+// blocks, skipping lodepng's colour conversion, so 1, 2 and 4-bit pixels
+// keep their exact palette indices. Interlaced files cannot be split into
+// bands; they are decoded whole by lodepng when opened and handed out from
+// memory. Errors are lodepng error codes.
+class PngTileReader {
+public:
+    PngTileReader();
+    ~PngTileReader();
+
+    // Reads the header and palette. png must stay valid until the last
+    // row has been read.
+    unsigned open(const unsigned char *png, std::size_t size);
+    // Decodes the next numRows rows of blocks, fewer at the bottom of the
+    // image, into band. band's size is set to the rows decoded; its palette
+    // is left alone.
+    unsigned readBlockRows(unsigned int numRows, Image *band);
+
+    unsigned int width() const { return imageWidth; }
+    unsigned int height() const { return imageHeight; }
+    const std::vector<Color> &palette() const { return imagePalette; }
+
+private:
+    unsigned openInterlaced(const unsigned char *png, std::size_t size);
+
+    unsigned int imageWidth;
+    unsigned int imageHeight;
+    unsigned int bitDepth;
+    std::vector<Color> imagePalette;
+    std::unique_ptr<InflateStream> inflater;
+    // The current and previous scanline, each a filter type byte followed
+    // by the packed pixels.
+    std::vector<unsigned char> lines;
+    std::size_t lineBytes;
+    unsigned int nextRow;
+    // The whole image, tile-major, for interlaced files.
+    std::vector<unsigned char> interlacedPixels;
+};
+
+#endif //PNG2TILE_PNGTILES_H
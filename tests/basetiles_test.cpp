@@ -0,0 +1,196 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+// Round-trips a tileset through -basetiles: an image is converted with
+// generated palettes, then converted again with its own tiles as base
+// tiles, from both the binary tile data and the -savetileimage PNG. Every
+// tile should then be a base tile, and the tilemap, base tiles and palettes
+// should still draw the original image.
+//
+// Usage: basetiles_test <png2tile>. Files are written to the current
+// directory.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../lodepng.h"
+
+#define IMAGE_WIDTH 128
+#define IMAGE_HEIGHT 64
+#define NUM_SHAPES 12
+// Colours 1-12 and 13-24 are drawn as two groups, so -numPals 2 is needed.
+#define GROUP_SIZE 12
+#define NUM_COLOURS (1 + 2 * GROUP_SIZE)
+
+typedef struct {
+    unsigned char pixels[64];
+} Shape;
+
+// Tiles drawn from a few shapes, each in one colour group, some of them
+// flipped, so that dedup and flips are exercised.
+static std::vector<unsigned char> make_image() {
+    std::mt19937 rng(7);
+    std::vector<Shape> shapes(NUM_SHAPES);
+    for (int s = 0; s < NUM_SHAPES; s++) {
+        int group = s % 2;
+        for (unsigned char &pixel : shapes[s].pixels) {
+            pixel = rng() % 3 == 0 ? 0 : (unsigned char) (1 + group * GROUP_SIZE + rng() % GROUP_SIZE);
+        }
+    }
+
+    std::vector<unsigned char> image(IMAGE_WIDTH * IMAGE_HEIGHT);
+    for (int ty = 0; ty < IMAGE_HEIGHT; ty += 8) {
+        for (int tx = 0; tx < IMAGE_WIDTH; tx += 8) {
+            const Shape &shape = shapes[rng() % NUM_SHAPES];
+            bool flipX = rng() % 2 != 0;
+            bool flipY = rng() % 2 != 0;
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    int sx = flipX ? 7 - x : x;
+                    int sy = flipY ? 7 - y : y;
+                    image[(ty + y) * IMAGE_WIDTH + tx + x] = shape.pixels[sy * 8 + sx];
+                }
+            }
+        }
+    }
+    return image;
+}
+
+static unsigned int colour(int index) {
+    return index == 0 ? 0x000000 : 0x102030 * (unsigned int) index & 0xFFFFFF;
+}
+
+static bool run(const std::string &png2tile, const std::string &args) {
+    std::string command = "\"" + png2tile + "\" " + args;
+    if (std::system(command.c_str()) != 0) {
+        printf("FAIL: %s\n", command.c_str());
+        return false;
+    }
+    return true;
+}
+
+static std::vector<unsigned int> read_gimp_palette(const char *filename) {
+    std::vector<unsigned char> data;
+    lodepng::load_file(data, filename);
+    std::istringstream in(std::string(data.begin(), data.end()));
+    std::string line;
+    std::vector<unsigned int> palette;
+    for (int lineNumber = 0; std::getline(in, line); lineNumber++) {
+        int r, g, b;
+        if (lineNumber >= 3 && sscanf(line.c_str(), "%d %d %d", &r, &g, &b) == 3) {
+            palette.push_back((unsigned int) (r << 16 | g << 8 | b));
+        }
+    }
+    return palette;
+}
+
+// Converts with base tiles from baseTiles and checks that no new tiles are
+// needed and the output draws image.
+static bool check_round_trip(const std::string &png2tile, const char *baseTiles, const std::vector<unsigned char> &image) {
+    if (!run(png2tile, std::string("image.png -quiet -generateNewPal -numPals 2 -binary -basetiles ") + baseTiles +
+                       " -savetiles new.bin -savetilemap map.bin -tilemapformat gen -pal gimp -savepalette pal.gpl")) {
+        return false;
+    }
+
+    std::vector<unsigned char> base, added, map;
+    lodepng::load_file(base, "base.bin");
+    lodepng::load_file(added, "new.bin");
+    lodepng::load_file(map, "map.bin");
+    std::vector<unsigned int> palette = read_gimp_palette("pal.gpl");
+    if (!added.empty()) {
+        printf("FAIL: %s: %d tiles were not matched to base tiles\n", baseTiles, (int) added.size() / 32);
+        return false;
+    }
+    if (map.size() != IMAGE_WIDTH / 8 * IMAGE_HEIGHT / 8 * 2 || palette.size() != 32) {
+        printf("FAIL: %s: unexpected tilemap or palette size\n", baseTiles);
+        return false;
+    }
+
+    int mismatches = 0;
+    for (int cell = 0; cell < (int) map.size() / 2; cell++) {
+        int entry = map[cell * 2] << 8 | map[cell * 2 + 1];
+        int tile = entry & 0x7FF;
+        bool flipX = (entry & 0x800) != 0;
+        bool flipY = (entry & 0x1000) != 0;
+        int pal = (entry >> 13) & 3;
+        if ((tile + 1) * 32 > (int) base.size()) {
+            printf("FAIL: %s: cell %d uses tile %d, which is not a base tile\n", baseTiles, cell, tile);
+            return false;
+        }
+        int tx = cell % (IMAGE_WIDTH / 8) * 8;
+        int ty = cell / (IMAGE_WIDTH / 8) * 8;
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                int sx = flipX ? 7 - x : x;
+                int sy = flipY ? 7 - y : y;
+                int value = 0;
+                for (int p = 0; p < 4; p++) {
+                    value |= (base[tile * 32 + sy * 4 + p] >> (7 - sx) & 1) << p;
+                }
+                if (palette[pal * 16 + value] != colour(image[(ty + y) * IMAGE_WIDTH + tx + x])) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    if (mismatches != 0) {
+        printf("FAIL: %s: %d pixels drawn in the wrong colour\n", baseTiles, mismatches);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: basetiles_test <png2tile>\n");
+        return 1;
+    }
+    std::string png2tile = argv[1];
+
+    std::vector<unsigned char> image = make_image();
+    lodepng::State state;
+    state.info_raw.colortype = LCT_PALETTE;
+    state.info_raw.bitdepth = 8;
+    for (int i = 0; i < NUM_COLOURS; i++) {
+        unsigned int c = colour(i);
+        lodepng_palette_add(&state.info_raw, c >> 16, c >> 8 & 0xFF, c & 0xFF, 0xFF);
+    }
+    lodepng_color_mode_copy(&state.info_png.color, &state.info_raw);
+    state.encoder.auto_convert = 0;
+    std::vector<unsigned char> png;
+    if (lodepng::encode(png, image, IMAGE_WIDTH, IMAGE_HEIGHT, state) || lodepng::save_file(png, "image.png")) {
+        printf("FAIL: could not write image.png\n");
+        return 1;
+    }
+
+    if (!run(png2tile, "image.png -quiet -generateNewPal -numPals 2 -binary -savetiles base.bin -savetileimage base.png") ||
+        !check_round_trip(png2tile, "base.bin", image) || !check_round_trip(png2tile, "base.png", image)) {
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// The same tile shapes drawn in four colour groups that all use colour 0,
+// starting from palettes that put two groups in one palette. Moving one of
+// those groups to the empty palette gives every group a palette of its own
+// with the same local numbering, so -palSwapDupes leaves one copy of each
+// shape. The optimizer has to find that move.
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../paletteopt.h"
+
+#define NUM_GROUPS 4
+#define NUM_PALETTES 4
+#define PALETTE_SIZE 16
+#define NUM_SHAPES 6
+
+// Group g draws its shapes in colour 0 and colours 1 + g, 5 + g and 9 + g.
+// The groups interleave, so two in one palette number their colours
+// differently from a group on its own.
+static int group_colour(int group, int slot) {
+    return slot == 0 ? 0 : 1 + group + (slot - 1) * NUM_GROUPS;
+}
+
+// Every shape uses colour 0 and two of the group's three other colours, so
+// no input holds a whole group and moving a single input leaves its
+// colours behind for the others.
+static void make_shape(int shape, int group, unsigned char *pixels) {
+    static const int PAIRS[3][2] = {{1, 2}, {2, 3}, {1, 3}};
+    const int *pair = PAIRS[shape % 3];
+    std::mt19937 rng(shape);
+    for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
+        int slot = rng() % 3;
+        pixels[i] = (unsigned char) group_colour(group, slot == 0 ? 0 : pair[slot - 1]);
+    }
+}
+
+int main() {
+    TileStore tiles;
+    std::vector<ColorSet> inputs;
+    for (int group = 0; group < NUM_GROUPS; group++) {
+        for (int shape = 0; shape < NUM_SHAPES; shape++) {
+            unsigned char pixels[NUM_PIXELS_IN_TILE];
+            make_shape(shape, group, pixels);
+            ColorSet colors;
+            for (unsigned char pixel : pixels) {
+                colors.insert(pixel);
+            }
+            Tile tile;
+            tile.setPixels(pixels);
+            tiles.add(tile, colors);
+            if (shape < 3) {
+                inputs.push_back(colors);
+            }
+        }
+    }
+
+    std::vector<ColorSet> palettes(NUM_PALETTES);
+    for (int group = 0; group < NUM_GROUPS; group++) {
+        for (int slot = 0; slot < 4; slot++) {
+            palettes[group < 2 ? 0 : group - 1].insert(group_colour(group, slot));
+        }
+    }
+
+    PaletteOptimizeResult result;
+    std::vector<ColorSet> optimized = optimizePalettes(inputs, palettes, tiles, 0, PALETTE_SIZE, false, true, &result);
+    printf("%lu of %lu moves kept: %d -> %d tiles\n", result.movesKept, result.movesTried,
+           (int) result.initialTiles, (int) result.finalTiles);
+    if (result.movesKept == 0 || result.finalTiles != NUM_SHAPES) {
+        printf("FAIL: expected %d tiles\n", NUM_SHAPES);
+        return 1;
+    }
+    for (int group = 0; group < NUM_GROUPS; group++) {
+        int holding = 0;
+        for (const ColorSet &palette : optimized) {
+            if (palette.contains(group_colour(group, 1))) holding++;
+        }
+        if (holding != 1) {
+            printf("FAIL: group %d is in %d palettes\n", group, holding);
+            return 1;
+        }
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -23,115 +23,113 @@ SOFTWARE.
 */
 
 #include "tile.h"
+#include "palettemap.h"
+#include "tilesimd.h"
 
-#include <algorithm>
 #include <cstring>
 #include <iostream>
-#include <map>
 #include <ostream>
-#include <set>
 
-Tile::Tile(uint16_t id, Image* image, int x, int y) {
-    this->id = id;
+Tile::Tile() : tilemapX(0), tilemapY(0), planes(), palette_index(0) {
+}
+
+Tile::Tile(Image* image, int x, int y) {
     this->tilemapX = x;
     this->tilemapY = y;
-    this->flipped_x = false;
-    this->flipped_y = false;
-    this->is_duplicate = false;
     this->palette_index = 0;
-    this->original_tile = nullptr;
-
-    unsigned char *ptr = &image->pixels[0] + y * image->width + x;
-    unsigned char *tile_ptr = data;
-    for (int i = 0; i < TILE_HEIGHT; i++) {
-        memcpy(tile_ptr, ptr, TILE_WIDTH);
-        tile_ptr += TILE_WIDTH;
-        ptr += image->width;
-    }
-}
-
-Tile::Tile(uint16_t id, bool flippedX, bool flippedY, bool isDuplicate, int palIdx, Tile *originalTile) : id(id),
-                                                                                                          flipped_x(flippedX),
-                                                                                                          flipped_y(flippedY),
-                                                                                                          is_duplicate(isDuplicate),
-                                                                                                          palette_index(palIdx),
-                                                                                                          original_tile(originalTile) {
 
+    tile_pack_planes(&image->pixels[image_block_offset(image, x, y)], TILE_WIDTH, planes);
 }
 
-Tile *Tile::flipX() {
-    Tile *flipped_tile = new Tile(id, true, flipped_y, is_duplicate, palette_index, original_tile);
-
-    for (int y = 0; y < TILE_HEIGHT; y++) {
-        for (int x = 0; x < TILE_WIDTH; x++) {
-            flipped_tile->data[y * TILE_WIDTH + x] = data[y * TILE_WIDTH + ((TILE_WIDTH - 1) - x)];
-        }
-    }
-
-    return flipped_tile;
+bool Tile::isDataEqual(const Tile &anotherTile) const {
+    return tile_planes_equal(planes, anotherTile.planes);
 }
 
-Tile *Tile::flipY() {
-    Tile *flipped_tile = new Tile(id, flipped_x, true, is_duplicate, palette_index, original_tile);
-
-    for (int x = 0; x < TILE_WIDTH; x++) {
-        for (int y = 0; y < TILE_HEIGHT; y++) {
-            flipped_tile->data[y * TILE_WIDTH + x] = data[(TILE_HEIGHT - 1 - y) * TILE_WIDTH + x];
-        }
-    }
+std::size_t Tile::hash() const {
+    return hashPlanes(planes);
+}
 
-    return flipped_tile;
+void Tile::getPixels(unsigned char *pixels) const {
+    tile_unpack_planes(planes, pixels);
 }
 
-Tile *Tile::flipXY() {
-    Tile *flipped_x_tile = flipX();
-    Tile *flipped_xy_tile = flipped_x_tile->flipY();
-    delete flipped_x_tile;
+void Tile::setPixels(const unsigned char *pixels) {
+    tile_pack_planes(pixels, TILE_WIDTH, planes);
+}
 
-    return flipped_xy_tile;
+std::size_t Tile::hashPlanes(const uint64_t *planes) {
+    return (std::size_t)tile_planes_hash(planes);
 }
 
-bool Tile::isDataEqual(Tile *anotherTile) {
-    int count = 0;
-    for (; count < NUM_PIXELS_IN_TILE; count++) {
-        if (data[count] != anotherTile->data[count]) {
+// Writes the tile in the given orientation to out.
+void Tile::orientation(int transform, uint64_t *out) const {
+    switch (transform) {
+        case TILE_TRANSFORM_FLIP_X:
+            tile_flip_x(planes, out);
+            break;
+        case TILE_TRANSFORM_FLIP_Y:
+            tile_flip_y(planes, out);
+            break;
+        case TILE_TRANSFORM_FLIP_XY:
+            tile_flip_xy(planes, out);
+            break;
+        default:
+            memcpy(out, planes, sizeof(planes));
             break;
-        }
-    }
-    if (count == NUM_PIXELS_IN_TILE) {
-        return true;
     }
-    return false;
 }
 
-bool Tile::validateColorUsage() const {
-    std::set<int> colorsUsed;
+void Tile::analyze(TileAnalysis *out) const {
+    unsigned char data[NUM_PIXELS_IN_TILE];
+    getPixels(data);
+    out->colors = ColorSet();
     for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
-        colorsUsed.insert(data[i]);
+        out->colors.insert(data[i]);
+    }
+    out->numColors = (int) out->colors.size();
+
+    if (out->numColors == 1) {
+        // Every orientation of a one-colour tile is the tile itself.
+        out->canonicalTransform = TILE_TRANSFORM_NONE;
+        return;
+    }
+
+    uint64_t orientations[NUM_TILE_TRANSFORMS][TILE_NUM_PLANES];
+    out->canonicalTransform = TILE_TRANSFORM_NONE;
+    for (int t = 0; t < NUM_TILE_TRANSFORMS; t++) {
+        orientation(t, orientations[t]);
+        if (memcmp(orientations[t], orientations[out->canonicalTransform], sizeof(planes)) < 0) {
+            out->canonicalTransform = t;
+        }
     }
-    return colorsUsed.size() <= MAX_COLOURS;
 }
 
-void Tile::setPalette(const std::vector<std::set<int>>& palette) {
-    std::set<int> colorsUsed;
-    for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
-        colorsUsed.insert(data[i]);
+void Tile::setPalette(PaletteMap &palettes, const ColorSet &colors) {
+    int index = palettes.find(colors);
+    if (index < 0) {
+        std::cerr << "Error: Could not find a palette for tile at (" << tilemapX << ", " << tilemapY << ")" << std::endl;
+        return;
     }
-    for (int i = 0; i < palette.size(); i++) {
-        auto pal = palette[i];
-        if (std::includes(pal.begin(), pal.end(), colorsUsed.begin(), colorsUsed.end())) {
-            palette_index = i;
-            std::map<int, int> colorMap;
-            int j = 0;
-            for (int color: pal) {
-                colorMap[color] = j;
-                j++;
-            }
-            for (int j = 0; j < NUM_PIXELS_IN_TILE; j++) {
-                data[j] = colorMap[data[j]];
-            }
-            return;
+    palette_index = index;
+    const unsigned char *table = palettes.remapTable(index);
+
+    if (colors.size() == 1) {
+        // A one-colour tile is its remapped colour in every plane.
+        int color = 0;
+        while (!colors.contains(color)) {
+            color++;
+        }
+        unsigned char entry = table[color];
+        for (int p = 0; p < TILE_NUM_PLANES; p++) {
+            planes[p] = (entry >> p) & 1 ? ~0ULL : 0;
         }
+        return;
+    }
+
+    unsigned char data[NUM_PIXELS_IN_TILE];
+    getPixels(data);
+    for (int i = 0; i < NUM_PIXELS_IN_TILE; i++) {
+        data[i] = table[data[i]];
     }
-    std::cerr << "Error: Could not find a palette for tile at (" << tilemapX << ", " << tilemapY << ")" << std::endl;
+    setPixels(data);
 }
@@ -24,37 +24,61 @@ SOFTWARE.
 #ifndef PNG2TILE_TILE_H
 #define PNG2TILE_TILE_H
 
+#include <cstddef>
 #include <cstdint>
-#include <set>
 
+#include "colorset.h"
 #include "image.h"
+#include "tilesimd.h"
 #define NUM_PIXELS_IN_TILE 64
 
+class PaletteMap;
+
 #define TILE_HEIGHT 8
 #define TILE_WIDTH 8
 
+// Orientation transforms, in the order duplicates are searched for.
+#define TILE_TRANSFORM_NONE 0
+#define TILE_TRANSFORM_FLIP_X 1
+#define TILE_TRANSFORM_FLIP_Y 2
+#define TILE_TRANSFORM_FLIP_XY 3
+#define NUM_TILE_TRANSFORMS 4
+
+// What one pass over a tile's pixels finds, computed once at extraction so
+// later stages do not rescan the pixels.
+typedef struct {
+    ColorSet colors;
+    int numColors;
+    // The transform giving the smallest orientation by memcmp, the earliest
+    // on ties. Dedup keys use that orientation.
+    int canonicalTransform;
+} TileAnalysis;
+
+// A single tile's pixels and where it came from. Tiles are short-lived
+// values; the unique tiles of an image live in a TileStore.
 class Tile {
 public:
-    uint16_t id;
     int tilemapX;
     int tilemapY;
-    unsigned char data[NUM_PIXELS_IN_TILE];
-    bool flipped_x;
-    bool flipped_y;
-    bool is_duplicate;
+    // Pixel indices packed as bitplanes, see tilesimd.h.
+    uint64_t planes[TILE_NUM_PLANES];
     int palette_index;
-    Tile *original_tile;
 
-    Tile(uint16_t id, Image *image, int x, int y);
-    Tile(uint16_t id, bool flippedX, bool flippedY, bool isDuplicate, int palIdx, Tile *originalTile);
+    Tile();
+    // (x, y) is the top left corner of one of image's blocks.
+    Tile(Image *image, int x, int y);
 
-    Tile *flipX();
-    Tile *flipY();
-    Tile *flipXY();
+    bool isDataEqual(const Tile &anotherTile) const;
+    std::size_t hash() const;
+    void orientation(int transform, uint64_t *out) const;
+    void analyze(TileAnalysis *out) const;
+    void getPixels(unsigned char *pixels) const;
+    void setPixels(const unsigned char *pixels);
+    // Picks the first palette holding all the tile's colours, which must be
+    // colors, and rewrites the pixels as entries of that palette.
+    void setPalette(PaletteMap &palettes, const ColorSet &colors);
 
-    bool isDataEqual(Tile *anotherTile);
-    bool validateColorUsage() const;
-    void setPalette(const std::vector<std::set<int>> &palette);
+    static std::size_t hashPlanes(const uint64_t *planes);
 };
 
 
@@ -0,0 +1,118 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "tileindex.h"
+
+#include <cstring>
+
+#define TILE_INDEX_INITIAL_SLOTS 1024
+
+TileIndex::TileIndex(bool mirrored) : mirrored(mirrored), slots(TILE_INDEX_INITIAL_SLOTS, 0) {
+}
+
+TileKey TileIndex::makeKey(const Tile &tile, const TileAnalysis &analysis) const {
+    TileKey key;
+    key.transform = mirrored ? analysis.canonicalTransform : TILE_TRANSFORM_NONE;
+    tile.orientation(key.transform, key.planes);
+    key.hash = Tile::hashPlanes(key.planes);
+    return key;
+}
+
+// Returns the entry number for key, or -1 with *slot set to the empty slot
+// where it would go.
+int TileIndex::findEntry(const TileKey &key, std::size_t *slot) const {
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = (std::size_t)key.hash & mask;
+    while (slots[i] != 0) {
+        uint32_t e = slots[i] - 1;
+        if (entries[e].hash == key.hash && tile_planes_equal(&keyPlanes[e * TILE_NUM_PLANES], key.planes)) {
+            return (int)e;
+        }
+        i = (i + 1) & mask;
+    }
+    *slot = i;
+    return -1;
+}
+
+bool TileIndex::find(const TileKey &key, uint32_t *tile, bool *flippedX, bool *flippedY) const {
+    std::size_t slot = 0;
+    int e = findEntry(key, &slot);
+    if (e < 0) {
+        return false;
+    }
+
+    // Transforms are their own inverses and commute, so the flip taking this
+    // tile onto the one stored under transform t is (key.transform ^ t).
+    // Searching flips in transform order matches the old unflipped, X, Y, XY
+    // search order.
+    int numFlips = mirrored ? NUM_TILE_TRANSFORMS : 1;
+    for (int flip = 0; flip < numFlips; flip++) {
+        uint32_t t = entries[e].byTransform[key.transform ^ flip];
+        if (t != TILE_INDEX_NO_TILE) {
+            *tile = t;
+            *flippedX = (flip & TILE_TRANSFORM_FLIP_X) != 0;
+            *flippedY = (flip & TILE_TRANSFORM_FLIP_Y) != 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileIndex::add(const TileKey &key, uint32_t tile) {
+    std::size_t slot = 0;
+    int e = findEntry(key, &slot);
+    if (e < 0) {
+        Entry entry;
+        entry.hash = key.hash;
+        for (uint32_t &t : entry.byTransform) {
+            t = TILE_INDEX_NO_TILE;
+        }
+        e = (int)entries.size();
+        entries.push_back(entry);
+        keyPlanes.insert(keyPlanes.end(), key.planes, key.planes + TILE_NUM_PLANES);
+        slots[slot] = (uint32_t)e + 1;
+        // Keep the load factor at or below one half.
+        if (entries.size() * 2 > slots.size()) {
+            grow();
+        }
+    }
+
+    // Keep the first occurrence of each orientation.
+    uint32_t &t = entries[e].byTransform[key.transform];
+    if (t == TILE_INDEX_NO_TILE) {
+        t = tile;
+    }
+}
+
+void TileIndex::grow() {
+    std::vector<uint32_t> newSlots(slots.size() * 2, 0);
+    std::size_t mask = newSlots.size() - 1;
+    for (std::size_t e = 0; e < entries.size(); e++) {
+        std::size_t i = (std::size_t)entries[e].hash & mask;
+        while (newSlots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        newSlots[i] = (uint32_t)e + 1;
+    }
+    slots.swap(newSlots);
+}
@@ -0,0 +1,81 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_TILEINDEX_H
+#define PNG2TILE_TILEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tile.h"
+
+#define TILE_INDEX_NO_TILE 0xffffffffu
+
+// Lookup key for a tile. When mirroring is enabled the key is the tile's
+// canonical orientation (see Tile::analyze), so all four orientations of
+// a tile share one key and one probe finds any of them.
+// Keys are built without touching the index's contents, so makeKey() may be
+// called from several threads while no tiles are being added.
+struct TileKey {
+    uint64_t planes[TILE_NUM_PLANES];
+    uint64_t hash;
+    int transform;
+};
+
+// Hash index over the pixel data of unique tiles, referring to tiles by
+// their TileStore index. Only the first tile added with a given content is
+// kept, so lookups always return the earliest matching tile.
+//
+// Open addressing over flat arrays: adding a tile never allocates except
+// when the table grows.
+class TileIndex {
+public:
+    explicit TileIndex(bool mirrored);
+
+    // analysis must come from tile.analyze().
+    TileKey makeKey(const Tile &tile, const TileAnalysis &analysis) const;
+    bool find(const TileKey &key, uint32_t *tile, bool *flippedX, bool *flippedY) const;
+    void add(const TileKey &key, uint32_t tile);
+    std::size_t size() const { return entries.size(); }
+
+private:
+    // The first tile seen in each orientation of a canonical tile, indexed by
+    // the transform that maps that orientation to the canonical one.
+    struct Entry {
+        uint64_t hash;
+        uint32_t byTransform[NUM_TILE_TRANSFORMS];
+    };
+
+    int findEntry(const TileKey &key, std::size_t *slot) const;
+    void grow();
+
+    bool mirrored;
+    std::vector<Entry> entries;
+    // Canonical planes of each entry, TILE_NUM_PLANES words per entry.
+    std::vector<uint64_t> keyPlanes;
+    // Hash table of entry numbers plus one; zero marks an empty slot.
+    std::vector<uint32_t> slots;
+};
+
+#endif //PNG2TILE_TILEINDEX_H
@@ -0,0 +1,505 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "tilesimd.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PNG2TILE_X86 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG2TILE_SSE2 1
+#endif
+// AVX2 and AVX-512 kernels are compiled with per-function target attributes
+// (or, on MSVC, need no flags at all) and only called when the CPU has them.
+#if defined(PNG2TILE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define PNG2TILE_AVX 1
+#endif
+
+#if defined(PNG2TILE_AVX)
+#include <immintrin.h>
+#elif defined(PNG2TILE_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(PNG2TILE_X86)
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define PNG2TILE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PNG2TILE_TARGET(isa)
+#endif
+
+#define TILE_ROWS 8
+#define TILE_ROW_PIXELS 8
+
+typedef struct {
+    void (*pack)(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes);
+    void (*flip_x)(const uint64_t *src, uint64_t *dst);
+    void (*flip_y)(const uint64_t *src, uint64_t *dst);
+    void (*flip_xy)(const uint64_t *src, uint64_t *dst);
+    bool (*equal)(const uint64_t *a, const uint64_t *b);
+    uint64_t (*hash)(const uint64_t *planes);
+} TileKernels;
+
+// Each plane is hashed as (lo32(plane ^ key) * hi32(plane ^ key)) + plane with
+// its halves swapped, the eight results are summed and the sum finalised with
+// the MurmurHash3 mixer. The per-plane part maps directly onto pmuludq.
+static const uint64_t HASH_KEYS[TILE_NUM_PLANES] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL
+};
+
+static inline uint64_t hash_finalise(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Portable kernels.
+
+// Gathers bit 0 of each of the eight bytes of a row into one byte, first byte
+// in bit 7. The multiplier places byte k's bit at bit 63 - k without carries.
+static inline uint64_t gather_row_bits(uint64_t row) {
+    return ((row & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56;
+}
+
+static void pack_scalar(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes) {
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        planes[p] = 0;
+    }
+    for (int y = 0; y < TILE_ROWS; y++) {
+        const unsigned char *rowPixels = pixels + y * rowStride;
+        uint64_t row = 0;
+        for (int x = 0; x < TILE_ROW_PIXELS; x++) {
+            row |= (uint64_t)rowPixels[x] << (x * 8);
+        }
+        for (int p = 0; p < TILE_NUM_PLANES; p++) {
+            planes[p] |= gather_row_bits(row >> p) << (y * 8);
+        }
+    }
+}
+
+// Reverses the bits of every byte (mirrors each row of a plane).
+static inline uint64_t reverse_byte_bits(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    return ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((v & 0x0f0f0f0f0f0f0f0fULL) << 4);
+}
+
+// Reverses the byte order (the row order of a plane).
+static inline uint64_t reverse_bytes(uint64_t v) {
+    v = ((v & 0x00ff00ff00ff00ffULL) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffULL);
+    v = ((v & 0x0000ffff0000ffffULL) << 16) | ((v >> 16) & 0x0000ffff0000ffffULL);
+    return (v << 32) | (v >> 32);
+}
+
+static void flip_x_scalar(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        dst[p] = reverse_byte_bits(src[p]);
+    }
+}
+
+static void flip_y_scalar(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        dst[p] = reverse_bytes(src[p]);
+    }
+}
+
+static void flip_xy_scalar(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        dst[p] = reverse_bytes(reverse_byte_bits(src[p]));
+    }
+}
+
+static bool equal_scalar(const uint64_t *a, const uint64_t *b) {
+    uint64_t diff = 0;
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        diff |= a[p] ^ b[p];
+    }
+    return diff == 0;
+}
+
+static uint64_t hash_scalar(const uint64_t *planes) {
+    uint64_t sum = 0;
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        uint64_t keyed = planes[p] ^ HASH_KEYS[p];
+        sum += (keyed & 0xffffffffULL) * (keyed >> 32) + ((planes[p] << 32) | (planes[p] >> 32));
+    }
+    return hash_finalise(sum);
+}
+
+static const TileKernels SCALAR_KERNELS = {
+    pack_scalar, flip_x_scalar, flip_y_scalar, flip_xy_scalar, equal_scalar, hash_scalar
+};
+
+#if defined(PNG2TILE_SSE2)
+
+// Reverses the bytes of each 64-bit lane: reverse the 16-bit words, then
+// swap the bytes within each word.
+static inline __m128i reverse_bytes_sse2(__m128i v) {
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i reverse_byte_bits_sse2(__m128i v) {
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0f);
+    v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 1), m1), _mm_slli_epi16(_mm_and_si128(v, m1), 1));
+    v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 2), m2), _mm_slli_epi16(_mm_and_si128(v, m2), 2));
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), m4), _mm_slli_epi16(_mm_and_si128(v, m4), 4));
+}
+
+static void pack_sse2(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes) {
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        planes[p] = 0;
+    }
+    for (int y = 0; y < TILE_ROWS; y += 2) {
+        __m128i rows = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(pixels + y * rowStride)),
+                                          _mm_loadl_epi64((const __m128i *)(pixels + (y + 1) * rowStride)));
+        // movemask collects the top bit of each byte, first byte lowest, so
+        // mirror the rows first to put the leftmost pixel in bit 7.
+        rows = reverse_bytes_sse2(rows);
+        for (int p = TILE_NUM_PLANES - 1; p >= 0; p--) {
+            planes[p] |= (uint64_t)(unsigned)_mm_movemask_epi8(rows) << (y * 8);
+            rows = _mm_add_epi8(rows, rows);
+        }
+    }
+}
+
+static void flip_x_sse2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + p));
+        _mm_storeu_si128((__m128i *)(dst + p), reverse_byte_bits_sse2(v));
+    }
+}
+
+static void flip_y_sse2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + p));
+        _mm_storeu_si128((__m128i *)(dst + p), reverse_bytes_sse2(v));
+    }
+}
+
+static void flip_xy_sse2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + p));
+        _mm_storeu_si128((__m128i *)(dst + p), reverse_bytes_sse2(reverse_byte_bits_sse2(v)));
+    }
+}
+
+static bool equal_sse2(const uint64_t *a, const uint64_t *b) {
+    __m128i eq = _mm_set1_epi8(-1);
+    for (int p = 0; p < TILE_NUM_PLANES; p += 2) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + p));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + p));
+        eq = _mm_and_si128(eq, _mm_cmpeq_epi8(va, vb));
+    }
+    return _mm_movemask_epi8(eq) == 0xffff;
+}
+
+static uint64_t hash_sse2(const uint64_t *planes) {
+    __m128i sum = _mm_setzero_si128();
+    for (int p = 0; p < TILE_NUM_PLANES; p += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(planes + p));
+        __m128i keyed = _mm_xor_si128(v, _mm_loadu_si128((const __m128i *)&HASH_KEYS[p]));
+        __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+        sum = _mm_add_epi64(sum, _mm_add_epi64(product, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, sum);
+    return hash_finalise(lanes[0] + lanes[1]);
+}
+
+static const TileKernels SSE2_KERNELS = {
+    pack_sse2, flip_x_sse2, flip_y_sse2, flip_xy_sse2, equal_sse2, hash_sse2
+};
+
+#endif
+
+#if defined(PNG2TILE_AVX)
+
+// Reverses the bytes of each 64-bit lane.
+PNG2TILE_TARGET("avx2")
+static inline __m256i reverse_bytes_avx2(__m256i v) {
+    const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    return _mm256_shuffle_epi8(v, mask);
+}
+
+// Reverses the bits of every byte with a nibble lookup table.
+PNG2TILE_TARGET("avx2")
+static inline __m256i reverse_byte_bits_avx2(__m256i v) {
+    const __m256i table = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+                                           0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi);
+}
+
+PNG2TILE_TARGET("avx2")
+static void pack_avx2(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes) {
+    __m256i rows[2];
+    for (int half = 0; half < 2; half++) {
+        long long row[4];
+        for (int y = 0; y < 4; y++) {
+            memcpy(&row[y], pixels + (half * 4 + y) * rowStride, sizeof(row[y]));
+        }
+        rows[half] = _mm256_setr_epi64x(row[0], row[1], row[2], row[3]);
+        // See pack_sse2: mirror the rows so movemask yields planar bytes.
+        rows[half] = reverse_bytes_avx2(rows[half]);
+    }
+    for (int p = TILE_NUM_PLANES - 1; p >= 0; p--) {
+        planes[p] = (uint64_t)(uint32_t)_mm256_movemask_epi8(rows[0])
+                    | ((uint64_t)(uint32_t)_mm256_movemask_epi8(rows[1]) << 32);
+        rows[0] = _mm256_add_epi8(rows[0], rows[0]);
+        rows[1] = _mm256_add_epi8(rows[1], rows[1]);
+    }
+}
+
+PNG2TILE_TARGET("avx2")
+static void flip_x_avx2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + p));
+        _mm256_storeu_si256((__m256i *)(dst + p), reverse_byte_bits_avx2(v));
+    }
+}
+
+PNG2TILE_TARGET("avx2")
+static void flip_y_avx2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + p));
+        _mm256_storeu_si256((__m256i *)(dst + p), reverse_bytes_avx2(v));
+    }
+}
+
+PNG2TILE_TARGET("avx2")
+static void flip_xy_avx2(const uint64_t *src, uint64_t *dst) {
+    for (int p = 0; p < TILE_NUM_PLANES; p += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + p));
+        _mm256_storeu_si256((__m256i *)(dst + p), reverse_bytes_avx2(reverse_byte_bits_avx2(v)));
+    }
+}
+
+PNG2TILE_TARGET("avx2")
+static bool equal_avx2(const uint64_t *a, const uint64_t *b) {
+    __m256i eqLow = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)a),
+                                      _mm256_loadu_si256((const __m256i *)b));
+    __m256i eqHigh = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + 4)),
+                                       _mm256_loadu_si256((const __m256i *)(b + 4)));
+    return _mm256_movemask_epi8(_mm256_and_si256(eqLow, eqHigh)) == -1;
+}
+
+PNG2TILE_TARGET("avx2")
+static uint64_t hash_avx2(const uint64_t *planes) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int p = 0; p < TILE_NUM_PLANES; p += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(planes + p));
+        __m256i keyed = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i *)&HASH_KEYS[p]));
+        __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+        sum = _mm256_add_epi64(sum, _mm256_add_epi64(product, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+    return hash_finalise(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+static const TileKernels AVX2_KERNELS = {
+    pack_avx2, flip_x_avx2, flip_y_avx2, flip_xy_avx2, equal_avx2, hash_avx2
+};
+
+PNG2TILE_TARGET("avx512f")
+static bool equal_avx512(const uint64_t *a, const uint64_t *b) {
+    return _mm512_cmpneq_epi64_mask(_mm512_loadu_si512((const void *)a), _mm512_loadu_si512((const void *)b)) == 0;
+}
+
+PNG2TILE_TARGET("avx512f")
+static uint64_t hash_avx512(const uint64_t *planes) {
+    __m512i v = _mm512_loadu_si512((const void *)planes);
+    __m512i keyed = _mm512_xor_si512(v, _mm512_loadu_si512((const void *)HASH_KEYS));
+    // The all-lanes maskz forms: GCC's unmasked ones pass an undefined source
+    // operand that -Wuninitialized reports.
+    __m512i product = _mm512_maskz_mul_epu32(0xFF, keyed, _mm512_maskz_srli_epi64(0xFF, keyed, 32));
+    __m512i sum = _mm512_add_epi64(product, _mm512_maskz_shuffle_epi32(0xFFFF, v, _MM_PERM_CDAB));
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void *)lanes, sum);
+    uint64_t total = 0;
+    for (int i = 0; i < 8; i++) {
+        total += lanes[i];
+    }
+    return hash_finalise(total);
+}
+
+// There is nothing to gain from 512-bit packing or flips, so reuse the AVX2 ones.
+static const TileKernels AVX512_KERNELS = {
+    pack_avx2, flip_x_avx2, flip_y_avx2, flip_xy_avx2, equal_avx512, hash_avx512
+};
+
+static bool cpu_supports(TileSimdLevel level) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave) {
+        return false;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (level == TILE_SIMD_AVX2) {
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+    }
+    return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+#else
+    __builtin_cpu_init();
+    if (level == TILE_SIMD_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif
+
+static const TileKernels *kernels_for(TileSimdLevel level) {
+    switch (level) {
+        case TILE_SIMD_SCALAR:
+            return &SCALAR_KERNELS;
+#if defined(PNG2TILE_SSE2)
+        case TILE_SIMD_SSE2:
+            return &SSE2_KERNELS;
+#endif
+#if defined(PNG2TILE_AVX)
+        case TILE_SIMD_AVX2:
+            return cpu_supports(TILE_SIMD_AVX2) ? &AVX2_KERNELS : nullptr;
+        case TILE_SIMD_AVX512:
+            return cpu_supports(TILE_SIMD_AVX512) ? &AVX512_KERNELS : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static TileSimdLevel best_level() {
+    for (int level = TILE_SIMD_AVX512; level > TILE_SIMD_SCALAR; level--) {
+        if (kernels_for((TileSimdLevel)level) != nullptr) {
+            return (TileSimdLevel)level;
+        }
+    }
+    return TILE_SIMD_SCALAR;
+}
+
+static TileSimdLevel active_level = best_level();
+static const TileKernels *active_kernels = kernels_for(active_level);
+
+void tile_pack_planes(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes) {
+    active_kernels->pack(pixels, rowStride, planes);
+}
+
+void tile_unpack_planes(const uint64_t *planes, unsigned char *pixels) {
+    for (int i = 0; i < TILE_ROWS * TILE_ROW_PIXELS; i++) {
+        // Pixel (x, y) is bit 8 * y + 7 - x of each plane.
+        int bit = (i & ~7) | (7 - (i & 7));
+        unsigned char pixel = 0;
+        for (int p = 0; p < TILE_NUM_PLANES; p++) {
+            pixel |= (unsigned char)(((planes[p] >> bit) & 1) << p);
+        }
+        pixels[i] = pixel;
+    }
+}
+
+void tile_flip_x(const uint64_t *src, uint64_t *dst) {
+    active_kernels->flip_x(src, dst);
+}
+
+void tile_flip_y(const uint64_t *src, uint64_t *dst) {
+    active_kernels->flip_y(src, dst);
+}
+
+void tile_flip_xy(const uint64_t *src, uint64_t *dst) {
+    active_kernels->flip_xy(src, dst);
+}
+
+bool tile_planes_equal(const uint64_t *a, const uint64_t *b) {
+    return active_kernels->equal(a, b);
+}
+
+uint64_t tile_planes_hash(const uint64_t *planes) {
+    return active_kernels->hash(planes);
+}
+
+static inline int popcount64(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+int tile_planes_distance(const uint64_t *a, const uint64_t *b) {
+    // A pixel differs if any of its bits differ, so OR the per-plane
+    // differences together and count the set pixel positions.
+    uint64_t diff = 0;
+    for (int p = 0; p < TILE_NUM_PLANES; p++) {
+        diff |= a[p] ^ b[p];
+    }
+    return popcount64(diff);
+}
+
+TileSimdLevel tile_simd_level() {
+    return active_level;
+}
+
+const char *tile_simd_level_name(TileSimdLevel level) {
+    switch (level) {
+        case TILE_SIMD_SCALAR: return "scalar";
+        case TILE_SIMD_SSE2: return "sse2";
+        case TILE_SIMD_AVX2: return "avx2";
+        case TILE_SIMD_AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool tile_simd_set_level(TileSimdLevel level) {
+    const TileKernels *kernels = kernels_for(level);
+    if (kernels == nullptr) {
+        return false;
+    }
+    active_level = level;
+    active_kernels = kernels;
+    return true;
+}
@@ -0,0 +1,68 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_TILESIMD_H
+#define PNG2TILE_TILESIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels operating on a tile's packed pixel data: eight 64-bit bitplanes,
+// one per bit of the pixel index. Byte y of plane p holds bit p of row y's
+// eight pixels with the leftmost pixel in bit 7, so planes 0-3 are exactly
+// the SMS/GG planar tile bytes.
+// Source and destination must not overlap. No alignment is required.
+//
+// The implementation is chosen at startup from the instruction sets the CPU
+// supports: AVX-512 or AVX2 when available, SSE2 as the x86 baseline and
+// portable C++ everywhere else. Every level produces identical results.
+
+#define TILE_NUM_PLANES 8
+
+typedef enum {
+    TILE_SIMD_SCALAR,
+    TILE_SIMD_SSE2,
+    TILE_SIMD_AVX2,
+    TILE_SIMD_AVX512
+} TileSimdLevel;
+
+// Packs 8 rows of 8 one-byte pixels, rowStride bytes apart.
+void tile_pack_planes(const unsigned char *pixels, std::size_t rowStride, uint64_t *planes);
+// Unpacks to 64 contiguous one-byte pixels.
+void tile_unpack_planes(const uint64_t *planes, unsigned char *pixels);
+
+void tile_flip_x(const uint64_t *src, uint64_t *dst);
+void tile_flip_y(const uint64_t *src, uint64_t *dst);
+void tile_flip_xy(const uint64_t *src, uint64_t *dst);
+bool tile_planes_equal(const uint64_t *a, const uint64_t *b);
+uint64_t tile_planes_hash(const uint64_t *planes);
+// Number of pixels (0-64) whose index differs between two tiles.
+int tile_planes_distance(const uint64_t *a, const uint64_t *b);
+
+TileSimdLevel tile_simd_level();
+const char *tile_simd_level_name(TileSimdLevel level);
+// Switches to another implementation. Returns false if the CPU (or this
+// build) does not support it.
+bool tile_simd_set_level(TileSimdLevel level);
+
+#endif //PNG2TILE_TILESIMD_H
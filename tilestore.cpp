@@ -0,0 +1,60 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "tilestore.h"
+
+#include <cstring>
+
+uint32_t TileStore::add(const Tile &tile, const ColorSet &colors) {
+    uint32_t index = (uint32_t)size();
+    planeData.insert(planeData.end(), tile.planes, tile.planes + TILE_NUM_PLANES);
+    paletteIndices.push_back(tile.palette_index);
+    colorSets.push_back(colors);
+    tilemapXs.push_back(tile.tilemapX);
+    tilemapYs.push_back(tile.tilemapY);
+    return index;
+}
+
+Tile TileStore::get(uint32_t index) const {
+    Tile tile;
+    memcpy(tile.planes, planes(index), sizeof(tile.planes));
+    tile.palette_index = paletteIndices[index];
+    tile.tilemapX = tilemapXs[index];
+    tile.tilemapY = tilemapYs[index];
+    return tile;
+}
+
+void TileStore::set(uint32_t index, const Tile &tile) {
+    memcpy(planes(index), tile.planes, sizeof(tile.planes));
+    paletteIndices[index] = tile.palette_index;
+    tilemapXs[index] = tile.tilemapX;
+    tilemapYs[index] = tile.tilemapY;
+}
+
+void TileStore::reserve(std::size_t numTiles) {
+    planeData.reserve(numTiles * TILE_NUM_PLANES);
+    paletteIndices.reserve(numTiles);
+    colorSets.reserve(numTiles);
+    tilemapXs.reserve(numTiles);
+    tilemapYs.reserve(numTiles);
+}
@@ -0,0 +1,70 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_TILESTORE_H
+#define PNG2TILE_TILESTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "colorset.h"
+#include "tile.h"
+
+// One cell of the tilemap: the tile it shows and how it is flipped.
+typedef struct {
+    uint32_t tile;
+    bool flipped_x;
+    bool flipped_y;
+    // The palette the cell selects, filled in once palettes are assigned.
+    int palette;
+} TilemapEntry;
+
+// Contiguous storage for an image's output tiles, one array per attribute.
+// A tile's index in the store is its tile id.
+class TileStore {
+public:
+    // colors is the set of colours the tile uses, see Tile::analyze.
+    uint32_t add(const Tile &tile, const ColorSet &colors);
+    Tile get(uint32_t index) const;
+    void set(uint32_t index, const Tile &tile);
+    void reserve(std::size_t numTiles);
+
+    std::size_t size() const { return paletteIndices.size(); }
+    const uint64_t *planes(uint32_t index) const { return &planeData[index * TILE_NUM_PLANES]; }
+    uint64_t *planes(uint32_t index) { return &planeData[index * TILE_NUM_PLANES]; }
+    int paletteIndex(uint32_t index) const { return paletteIndices[index]; }
+    // The colours given to add(). Not updated by set().
+    const ColorSet &colors(uint32_t index) const { return colorSets[index]; }
+    ColorSet &colors(uint32_t index) { return colorSets[index]; }
+
+private:
+    std::vector<uint64_t> planeData;
+    std::vector<int> paletteIndices;
+    std::vector<ColorSet> colorSets;
+    // Position in the source image, for diagnostics.
+    std::vector<int> tilemapXs;
+    std::vector<int> tilemapYs;
+};
+
+#endif //PNG2TILE_TILESTORE_H
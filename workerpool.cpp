@@ -0,0 +1,83 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "workerpool.h"
+
+WorkerPool::WorkerPool(unsigned int numThreads)
+    : task(nullptr), numTasks(0), nextTask(0), numFinished(0), batch(0), stopping(false) {
+    for (unsigned int i = 1; i < numThreads; i++) {
+        threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(unsigned int count, const std::function<void(unsigned int)> &batchTask) {
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &batchTask;
+    numTasks = count;
+    nextTask = 0;
+    numFinished = 0;
+    batch++;
+    if (!threads.empty()) {
+        wake.notify_all();
+    }
+    runTasks(lock);
+    finished.wait(lock, [&]() { return numFinished == numTasks; });
+    task = nullptr;
+}
+
+void WorkerPool::work() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&]() { return stopping || batch != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = batch;
+        runTasks(lock);
+    }
+}
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex> &lock) {
+    while (nextTask < numTasks) {
+        unsigned int i = nextTask++;
+        lock.unlock();
+        (*task)(i);
+        lock.lock();
+        if (++numFinished == numTasks) {
+            finished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2026 Eric Fry
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef PNG2TILE_WORKERPOOL_H
+#define PNG2TILE_WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that is started once and handed batches of tasks,
+// so the cost of starting threads does not grow with the number of batches.
+// The thread calling run() works on the batch too.
+class WorkerPool {
+public:
+    // numThreads counts the calling thread, so numThreads - 1 threads are
+    // started.
+    explicit WorkerPool(unsigned int numThreads);
+    ~WorkerPool();
+
+    unsigned int size() const { return (unsigned int) threads.size() + 1; }
+
+    // Calls task(i) for every i in [0, numTasks), in no particular order,
+    // and returns once all of them have finished.
+    void run(unsigned int numTasks, const std::function<void(unsigned int)> &task);
+
+private:
+    void work();
+    // Runs the batch's unclaimed tasks. lock is held on entry and on return.
+    void runTasks(std::unique_lock<std::mutex> &lock);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(unsigned int)> *task;
+    unsigned int numTasks;
+    unsigned int nextTask;
+    unsigned int numFinished;
+    // Bumped for every batch so each worker joins each batch once.
+    uint64_t batch;
+    bool stopping;
+};
+
+#endif //PNG2TILE_WORKERPOOL_H